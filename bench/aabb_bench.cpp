@@ -0,0 +1,124 @@
+/**
+ * @brief 包围盒求交的微基准: 比较aabb::entry(使用光线预先计算的方向倒数与符号选取平面)
+ * 与原先每次求交都做除法、按符号交换参数并逐轴提前退出的实现, 输出每次求交的耗时以及两者结果的一致性
+ */
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "aabb.hpp"
+#include "ray.hpp"
+
+namespace {
+/**
+ * @brief 原先的包围盒求交实现, 仅用于对比. 与aabb::entry一样允许内联, 和遍历时的情形相同
+ */
+std::optional<float> legacy_entry(const aabb &box, const ray &r, float tmin, float tmax) {
+    const auto direction = r.direction();
+    const auto origin = r.origin();
+    for (int i = 0; i < 3; i++) {
+        const float invd = 1.0F / direction[i];
+        float t0 = (box.low()[i] - origin[i]) * invd;
+        float t1 = (box.high()[i] - origin[i]) * invd;
+        if (invd < 0.0F) {
+            std::swap(t0, t1);
+        }
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+        if (tmin >= tmax) {
+            return std::nullopt;
+        }
+    }
+    return tmin;
+}
+
+template <typename Func>
+double time_ns(Func &&func, std::size_t n_tests) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const auto end = std::chrono::steady_clock::now();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() /
+           (double)n_tests;
+}
+}  // namespace
+
+int main() {
+    constexpr int n_boxes = 1024;
+    constexpr int n_rays = 4096;
+    constexpr float tmin = 0.001F;
+    constexpr float tmax = 100;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    auto random_point = [&] { return point_t{dist(gen), dist(gen), dist(gen)}; };
+
+    std::vector<aabb> boxes;
+    for (int i = 0; i < n_boxes; i++) {
+        const auto center = random_point();
+        const auto p0 = center + 0.2F * random_point();
+        const auto p1 = center + 0.2F * random_point();
+        boxes.emplace_back(point_t{std::min(p0[0], p1[0]), std::min(p0[1], p1[1]),
+                                   std::min(p0[2], p1[2])},
+                           point_t{std::max(p0[0], p1[0]), std::max(p0[1], p1[1]),
+                                   std::max(p0[2], p1[2])});
+    }
+    // 大部分光线从外围射向中心附近; 每16条中有一条平行于某个坐标轴, 起点落在某个包围盒的边界平面上,
+    // 用来检查方向分量为0时两种实现的结果是否一致
+    std::vector<ray> rays;
+    for (int i = 0; i < n_rays; i++) {
+        if (i % 16 == 0) {
+            const auto &box = boxes[i % n_boxes];
+            const int axis = (i / 16) % 3;
+            point_t origin = box.low() - point_t{2, 2, 2};
+            origin[(axis + 1) % 3] = box.low()[(axis + 1) % 3];
+            const int other = (axis + 2) % 3;
+            origin[other] = 0.5F * (box.low()[other] + box.high()[other]);
+            vec3_t direction{0, 0, 0};
+            direction[axis] = 1;
+            rays.emplace_back(origin, direction);
+            continue;
+        }
+        const auto origin = 4.0F * random_point();
+        rays.emplace_back(origin, 0.5F * random_point() - origin);
+    }
+
+    constexpr std::size_t n_tests = (std::size_t)n_boxes * n_rays;
+    std::size_t legacy_hits = 0;
+    std::size_t new_hits = 0;
+    const double legacy_ns = time_ns(
+        [&] {
+            for (const auto &r : rays) {
+                for (const auto &box : boxes) {
+                    legacy_hits += legacy_entry(box, r, tmin, tmax).has_value() ? 1 : 0;
+                }
+            }
+        },
+        n_tests);
+    const double new_ns = time_ns(
+        [&] {
+            for (const auto &r : rays) {
+                for (const auto &box : boxes) {
+                    new_hits += box.entry(r, tmin, tmax).has_value() ? 1 : 0;
+                }
+            }
+        },
+        n_tests);
+
+    std::size_t mismatches = 0;
+    for (const auto &r : rays) {
+        for (const auto &box : boxes) {
+            if (legacy_entry(box, r, tmin, tmax) != box.entry(r, tmin, tmax)) {
+                mismatches++;
+            }
+        }
+    }
+
+    std::cout << "tests: " << n_tests << "\n";
+    std::cout << "legacy:      " << legacy_ns << " ns/test, " << legacy_hits << " hits\n";
+    std::cout << "precomputed: " << new_ns << " ns/test, " << new_hits << " hits\n";
+    std::cout << "speedup: " << legacy_ns / new_ns << "x\n";
+    std::cout << "mismatches: " << mismatches << "\n";
+    return 0;
+}
@@ -0,0 +1,130 @@
+/**
+ * @brief 材质引用方式的多线程基准: 多个线程同时对Cornell box式的场景求交并构造hit_record.
+ * 比较hit_record中使用不持有所有权的材质指针与原先复制shared_ptr<material>两种方式,
+ * 后者每次复制与析构都要原子地修改少数几个墙面材质共享的引用计数. 按1、2、4直到硬件线程数
+ * 输出每条光线的耗时
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bvh.hpp"
+#include "material.hpp"
+#include "ray.hpp"
+#include "rectangle.hpp"
+
+namespace {
+/**
+ * @brief 原先的交点信息, 仅用于对比: 材质以shared_ptr保存
+ */
+struct legacy_record {
+    hit_record rec;
+    std::shared_ptr<material> pmat;
+};
+
+using materials_t = std::vector<std::shared_ptr<material>>;
+
+const std::shared_ptr<material> &owner_of(const materials_t &materials, const material *pmat) {
+    return *std::find_if(materials.begin(), materials.end(),
+                         [&](const auto &owner) { return owner.get() == pmat; });
+}
+
+/**
+ * @brief 与原先的实现相同, 交点信息连同材质的shared_ptr按值返回. noinline防止复制被优化掉
+ */
+[[gnu::noinline]] std::optional<legacy_record> legacy_hit(const bvh &scene,
+                                                          const materials_t &materials,
+                                                          const ray &r) {
+    const auto record = scene.hit(r, 0.001F, 1e30F);
+    if (!record.has_value()) {
+        return std::nullopt;
+    }
+    return legacy_record{record.value(), owner_of(materials, record->pmat)};
+}
+
+[[gnu::noinline]] hit_res_t handle_hit(const bvh &scene, const materials_t &materials,
+                                       const ray &r) {
+    auto record = scene.hit(r, 0.001F, 1e30F);
+    if (!record.has_value()) {
+        return std::nullopt;
+    }
+    // 与legacy_hit做相同的查找, 两者只差在是否复制shared_ptr
+    record->pmat = owner_of(materials, record->pmat).get();
+    return record;
+}
+
+/**
+ * @brief n_threads个线程各自处理全部光线, 返回每条光线的平均耗时
+ */
+template <typename Func>
+double ns_per_ray(int n_threads, const std::vector<ray> &rays, Func &&func) {
+    std::vector<std::thread> threads;
+    std::atomic<std::size_t> hits{0};
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n_threads; i++) {
+        threads.emplace_back([&] {
+            // 计数保存在线程自己的栈上, 避免计数器本身的伪共享干扰测量
+            std::size_t local_hits = 0;
+            for (const auto &r : rays) {
+                local_hits += func(r) ? 1 : 0;
+            }
+            hits += local_hits;
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() /
+           (double)(rays.size() * n_threads);
+}
+}  // namespace
+
+int main() {
+    constexpr int n_rays = 1 << 18;
+    // 五面墙加顶部的一小块矩形, 只有三种材质, 几乎所有光线都落在同几个材质上
+    const std::shared_ptr<material> white = std::make_shared<lambertian>(color_t{0.8, 0.8, 0.8});
+    const std::shared_ptr<material> red = std::make_shared<lambertian>(color_t{0.8, 0.1, 0.1});
+    const std::shared_ptr<material> green = std::make_shared<lambertian>(color_t{0.1, 0.8, 0.1});
+    auto world = std::make_shared<world_t>();
+    world->rectangles.emplace_back(point_t{-50, -50, -50}, vec3_t{100, 0, 0}, vec3_t{0, 0, 100},
+                                   white.get());
+    world->rectangles.emplace_back(point_t{-50, 50, -50}, vec3_t{0, 0, 100}, vec3_t{100, 0, 0},
+                                   white.get());
+    world->rectangles.emplace_back(point_t{-50, -50, 50}, vec3_t{0, 100, 0}, vec3_t{100, 0, 0},
+                                   white.get());
+    world->rectangles.emplace_back(point_t{-50, -50, -50}, vec3_t{0, 100, 0}, vec3_t{0, 0, 100},
+                                   red.get());
+    world->rectangles.emplace_back(point_t{50, -50, -50}, vec3_t{0, 0, 100}, vec3_t{0, 100, 0},
+                                   green.get());
+    world->rectangles.emplace_back(point_t{-10, 49, -10}, vec3_t{20, 0, 0}, vec3_t{0, 0, 20},
+                                   white.get());
+    const materials_t materials = {white, red, green};
+    const bvh scene{world, bvh::config{}};
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    std::vector<ray> rays;
+    for (int i = 0; i < n_rays; i++) {
+        rays.emplace_back(point_t{40 * dist(gen), 40 * dist(gen), 40 * dist(gen)},
+                          vec3_t{dist(gen), dist(gen), dist(gen)});
+    }
+
+    const int max_threads = std::max(1U, std::thread::hardware_concurrency());
+    std::cout << "hardware threads: " << max_threads << "\n";
+    for (int n_threads = 1; n_threads <= std::max(max_threads, 4); n_threads *= 2) {
+        const double legacy_ns = ns_per_ray(n_threads, rays, [&](const ray &r) {
+            return legacy_hit(scene, materials, r).has_value();
+        });
+        const double handle_ns = ns_per_ray(n_threads, rays, [&](const ray &r) {
+            return handle_hit(scene, materials, r).has_value();
+        });
+        std::cout << n_threads << " threads: shared_ptr " << legacy_ns << " ns/ray, handle "
+                  << handle_ns << " ns/ray, speedup " << legacy_ns / handle_ns << "x\n";
+    }
+    return 0;
+}
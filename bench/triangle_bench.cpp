@@ -0,0 +1,187 @@
+/**
+ * @brief 三角形求交的微基准: 比较triangle::hit(预计算边的Möller–Trumbore算法)
+ * 与原先基于平面方程和三次叉乘开方求重心坐标的实现, 输出每次求交的耗时以及两者结果的一致性
+ */
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "aabb.hpp"
+#include "ray.hpp"
+#include "triangle.hpp"
+
+namespace {
+/**
+ * @brief 原先的三角形实现, 仅用于对比. 与triangle一样通过hittable的虚函数求交, 并构造hit_record
+ */
+class legacy_triangle : public hittable {
+    std::array<point_t, 3> vertices_;
+    unit_vec3 normal_;
+    float dist_to_origin_;
+    float area2_;
+    std::array<tex_coords_t, 3> tex_coords_;
+    std::array<vec3_t, 3> edges_;
+
+public:
+    legacy_triangle(const point_t &point0, const point_t &point1, const point_t &point2)
+        : vertices_{point0, point1, point2}, tex_coords_{{{0, 0}, {1, 0}, {0, 1}}} {
+        normal_ = (point1 - point0).cross(point2 - point1).normalized();
+        dist_to_origin_ = -normal_.dot(point0);
+        edges_ = {point2 - point1, point0 - point2, point1 - point0};
+        area2_ = edges_[0].cross(edges_[1]).len();
+    }
+
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const override {
+        const float divisor = normal_.dot(r.direction());
+        if (divisor == 0) {
+            return std::nullopt;
+        }
+        const float t = -(normal_.dot(r.origin()) + dist_to_origin_) / divisor;
+        if (t < tmin || t > tmax) {
+            return std::nullopt;
+        }
+        const point_t point = r.point_at(t);
+        std::array<float, 3> bary{};
+        for (int i = 0; i < 3; i++) {
+            bary.at(i) = edges_.at(i).cross(point - vertices_.at((i + 1) % 3)).len() / area2_;
+            if (bary.at(i) < 0 || bary.at(i) > 1) {
+                return std::nullopt;
+            }
+        }
+        const float diff = std::abs(bary[0] + bary[1] + bary[2] - 1);
+        if (diff > std::numeric_limits<float>::epsilon()) {
+            return std::nullopt;
+        }
+        return intersection{t, {bary[1], bary[2]}, 0, this};
+    }
+
+    [[nodiscard]] hit_record surface_interaction(const ray &r,
+                                                 const intersection &isect) const override {
+        const std::array<float, 3> bary = {1 - isect.uv[0] - isect.uv[1], isect.uv[0],
+                                           isect.uv[1]};
+        const float divisor = normal_.dot(r.direction());
+        hit_record rec;
+        rec.ray_param = isect.ray_param;
+        rec.point = r.point_at(isect.ray_param);
+        rec.outside = divisor < 0;
+        rec.normal = divisor < 0 ? normal_ : -normal_;
+        rec.tex_coords = {0, 0};
+        for (int i = 0; i < 3; i++) {
+            rec.tex_coords.at(0) += bary.at(i) * tex_coords_.at(i).at(0);
+            rec.tex_coords.at(1) += bary.at(i) * tex_coords_.at(i).at(1);
+        }
+        return rec;
+    }
+
+    [[nodiscard]] aabb bounding_box() const override {
+        return aabb{vertices_[0], vertices_[0]}
+            .union_with(aabb{vertices_[1], vertices_[1]})
+            .union_with(aabb{vertices_[2], vertices_[2]});
+    }
+};
+
+template <typename Func>
+double time_ns(Func &&func, std::size_t n_tests) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const auto end = std::chrono::steady_clock::now();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() /
+           (double)n_tests;
+}
+}  // namespace
+
+int main() {
+    constexpr int n_triangles = 1024;
+    constexpr int n_rays = 4096;
+    constexpr float tmax = 100;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    auto random_point = [&] { return point_t{dist(gen), dist(gen), dist(gen)}; };
+
+    std::vector<std::shared_ptr<hittable>> triangles;
+    std::vector<std::shared_ptr<hittable>> legacy;
+    for (int i = 0; i < n_triangles; i++) {
+        const auto center = random_point();
+        const auto p0 = center + 0.3F * random_point();
+        const auto p1 = center + 0.3F * random_point();
+        const auto p2 = center + 0.3F * random_point();
+        triangles.push_back(std::make_shared<triangle>(p0, p1, p2, tex_coords_t{0, 0},
+                                                       tex_coords_t{1, 0}, tex_coords_t{0, 1},
+                                                       nullptr));
+        legacy.push_back(std::make_shared<legacy_triangle>(p0, p1, p2));
+    }
+    // 光线从外围的球面射向中心附近, 使相当一部分测试命中
+    std::vector<ray> rays;
+    for (int i = 0; i < n_rays; i++) {
+        const auto origin = 4.0F * random_point();
+        rays.emplace_back(origin, 0.5F * random_point() - origin);
+    }
+    const std::size_t n_tests = (std::size_t)n_triangles * n_rays;
+
+    std::size_t new_hits = 0;
+    const double new_ns = time_ns(
+        [&] {
+            for (const auto &r : rays) {
+                for (const auto &tri : triangles) {
+                    new_hits += tri->hit(r, 0, tmax).has_value() ? 1 : 0;
+                }
+            }
+        },
+        n_tests);
+    // occluded()不构造hit_record, 只反映求交本身的开销
+    std::size_t new_occluded = 0;
+    const double occluded_ns = time_ns(
+        [&] {
+            for (const auto &r : rays) {
+                for (const auto &tri : triangles) {
+                    new_occluded += tri->occluded(r, 0, tmax) ? 1 : 0;
+                }
+            }
+        },
+        n_tests);
+    std::size_t legacy_hits = 0;
+    const double legacy_ns = time_ns(
+        [&] {
+            for (const auto &r : rays) {
+                for (const auto &tri : legacy) {
+                    legacy_hits += tri->hit(r, 0, tmax).has_value() ? 1 : 0;
+                }
+            }
+        },
+        n_tests);
+
+    // 逐对比较: 原实现因重心坐标之和的误差判定而漏掉的交点, 以及两者交点参数的最大差距
+    std::size_t only_new = 0;
+    std::size_t only_legacy = 0;
+    float max_diff = 0;
+    for (const auto &r : rays) {
+        for (int i = 0; i < n_triangles; i++) {
+            const auto a = triangles[i]->hit(r, 0, tmax);
+            const auto b = legacy[i]->hit(r, 0, tmax);
+            if (a.has_value() && b.has_value()) {
+                max_diff = std::max(max_diff, std::abs(a->ray_param - b->ray_param));
+            } else if (a.has_value()) {
+                only_new++;
+            } else if (b.has_value()) {
+                only_legacy++;
+            }
+        }
+    }
+
+    std::cout << "tests: " << n_tests << "\n";
+    std::cout << "legacy:          " << legacy_ns << " ns/test, " << legacy_hits << " hits\n";
+    std::cout << "moller-trumbore: " << new_ns << " ns/test, " << new_hits << " hits\n";
+    std::cout << "moller-trumbore occluded: " << occluded_ns << " ns/test, " << new_occluded
+              << " hits\n";
+    std::cout << "speedup: " << legacy_ns / new_ns << "x (hit), " << legacy_ns / occluded_ns
+              << "x (occluded)\n";
+    std::cout << "hits found only by legacy: " << only_legacy
+              << ", only by moller-trumbore: " << only_new << ", max t difference: " << max_diff
+              << "\n";
+    return 0;
+}
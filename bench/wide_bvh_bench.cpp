@@ -0,0 +1,103 @@
+/**
+ * @brief 多叉bvh的微基准: 比较二叉bvh与由它折叠得到的wide_bvh, 场景由整数坐标与半径的球面组成.
+ * 除了随机光线, 还检查沿坐标轴方向、恰好位于球面包围盒某个面上(与球面相切)的光线:
+ * 这时方向分量为0, 包围盒所在平面的参数是0*inf=NaN, 两种bvh的结果必须一致.
+ * 输出每条光线的耗时以及结果的一致性
+ */
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "bvh.hpp"
+#include "ray.hpp"
+#include "sphere.hpp"
+#include "utils.hpp"
+#include "wide_bvh.hpp"
+
+namespace {
+template <typename Func>
+double ns_per_ray(Func &&func, const std::vector<ray> &rays) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const auto end = std::chrono::steady_clock::now();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() /
+           (double)rays.size();
+}
+
+/**
+ * @brief 逐条比较最近交点与是否遮挡
+ */
+template <typename Target>
+std::size_t mismatches(const Target &target, const bvh &binary, const std::vector<ray> &rays) {
+    std::size_t count = 0;
+    for (const auto &r : rays) {
+        const auto expected = binary.intersect(r, 0.001F, 1e30F);
+        const auto actual = target.intersect(r, 0.001F, 1e30F);
+        if (expected.has_value() != actual.has_value() ||
+            (expected.has_value() && expected->ray_param != actual->ray_param) ||
+            binary.occluded(r, 0.001F, 1e30F) != target.occluded(r, 0.001F, 1e30F)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+template <typename Target>
+void run(const char *name, const Target &target, const bvh &binary,
+         const std::vector<ray> &rays, const std::vector<ray> &grazing, double binary_ns) {
+    std::size_t hits = 0;
+    const double ns = ns_per_ray(
+        [&] {
+            for (const auto &r : rays) {
+                hits += target.intersect(r, 0.001F, 1e30F).has_value() ? 1 : 0;
+            }
+        },
+        rays);
+    std::cout << "\t" << name << ": " << ns << " ns/ray, " << hits << " hits, speedup "
+              << binary_ns / ns << "x, mismatches " << mismatches(target, binary, rays)
+              << ", grazing mismatches " << mismatches(target, binary, grazing) << "\n";
+}
+}  // namespace
+
+int main() {
+    constexpr int n_spheres = 4096;
+    constexpr int n_rays = 1 << 16;
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> coord(-200, 200);
+    std::uniform_int_distribution<int> radius(1, 4);
+    std::uniform_real_distribution<float> dist(-1, 1);
+
+    auto world = std::make_shared<world_t>();
+    std::vector<ray> grazing;
+    for (int i = 0; i < n_spheres; i++) {
+        const point_t center{(float)coord(gen), (float)coord(gen), (float)coord(gen)};
+        const auto r = (float)radius(gen);
+        world->spheres.emplace_back(center, r, nullptr);
+        // 位于包围盒的上表面与侧面上, 与球面相切; 判别式恰好为0, 切点算作交点
+        grazing.emplace_back(center + vec3_t{-300, r, 0}, vec3_t{1, 0, 0});
+        grazing.emplace_back(center + vec3_t{0, -300, -r}, vec3_t{0, 1, 0});
+    }
+    std::vector<ray> rays;
+    for (int i = 0; i < n_rays; i++) {
+        rays.emplace_back(point_t{250 * dist(gen), 250 * dist(gen), 250 * dist(gen)},
+                          vec3_t{dist(gen), dist(gen), dist(gen)});
+    }
+
+    const bvh binary{world, bvh::config{}};
+    std::size_t binary_hits = 0;
+    const double binary_ns = ns_per_ray(
+        [&] {
+            for (const auto &r : rays) {
+                binary_hits += binary.intersect(r, 0.001F, 1e30F).has_value() ? 1 : 0;
+            }
+        },
+        rays);
+    std::cout << n_spheres << " spheres, " << grazing.size() << " grazing rays:\n";
+    std::cout << "\tbvh: " << binary_ns << " ns/ray, " << binary_hits << " hits\n";
+    run("wide_bvh<4>", wide_bvh<4>{binary}, binary, rays, grazing, binary_ns);
+    if (cpu_supports_avx2()) {
+        run("wide_bvh<8>", wide_bvh<8>{binary}, binary, rays, grazing, binary_ns);
+    }
+    return 0;
+}
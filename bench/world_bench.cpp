@@ -0,0 +1,94 @@
+/**
+ * @brief 不使用bvh时场景求交的微基准: 比较逐个调用虚函数的world_t与按组打包为SIMD块的
+ * packed_world, 场景由随机的球面与Cornell box式的墙面组成. 输出每条光线的耗时以及结果的一致性
+ */
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "packed_world.hpp"
+#include "ray.hpp"
+#include "rectangle.hpp"
+#include "sphere.hpp"
+#include "utils.hpp"
+
+namespace {
+template <typename Func>
+double ns_per_ray(Func &&func, const std::vector<ray> &rays) {
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const auto end = std::chrono::steady_clock::now();
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() /
+           (double)rays.size();
+}
+
+/**
+ * @brief 统计全部光线的最近交点, 并与world_t的结果逐条比较
+ */
+template <typename Target>
+void run(const char *name, const Target &target, const world_t &world,
+         const std::vector<ray> &rays, double world_ns) {
+    std::size_t hits = 0;
+    const double ns = ns_per_ray(
+        [&] {
+            for (const auto &r : rays) {
+                hits += target.intersect(r, 0.001F, 1e30F).has_value() ? 1 : 0;
+            }
+        },
+        rays);
+    std::size_t mismatches = 0;
+    for (const auto &r : rays) {
+        const auto expected = intersect(world, r, 0.001F, 1e30F);
+        const auto actual = target.intersect(r, 0.001F, 1e30F);
+        if (expected.has_value() != actual.has_value() ||
+            (expected.has_value() && expected->ray_param != actual->ray_param)) {
+            mismatches++;
+        }
+    }
+    std::cout << "\t" << name << ": " << ns << " ns/ray, " << hits << " hits, speedup "
+              << world_ns / ns << "x, mismatches " << mismatches << "\n";
+}
+}  // namespace
+
+int main() {
+    constexpr int n_rays = 1 << 15;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-1, 1);
+    std::vector<ray> rays;
+    for (int i = 0; i < n_rays; i++) {
+        rays.emplace_back(point_t{40 * dist(gen), 40 * dist(gen), 40 * dist(gen)},
+                          vec3_t{dist(gen), dist(gen), dist(gen)});
+    }
+
+    for (const int n_spheres : {4, 16, 64, 256}) {
+        auto world = std::make_shared<world_t>();
+        world->rectangles.emplace_back(point_t{-50, -50, -50}, vec3_t{100, 0, 0}, vec3_t{0, 0, 100},
+                                       nullptr);
+        world->rectangles.emplace_back(point_t{-50, 50, -50}, vec3_t{0, 0, 100}, vec3_t{100, 0, 0},
+                                       nullptr);
+        world->rectangles.emplace_back(point_t{-50, -50, -50}, vec3_t{0, 100, 0}, vec3_t{0, 0, 100},
+                                       nullptr);
+        for (int i = 0; i < n_spheres; i++) {
+            world->spheres.emplace_back(point_t{45 * dist(gen), 45 * dist(gen), 45 * dist(gen)},
+                                        2 + 3 * (dist(gen) + 1), nullptr);
+        }
+
+        std::size_t world_hits = 0;
+        const double world_ns = ns_per_ray(
+            [&] {
+                for (const auto &r : rays) {
+                    world_hits += intersect(*world, r, 0.001F, 1e30F).has_value() ? 1 : 0;
+                }
+            },
+            rays);
+        std::cout << n_spheres << " spheres + 3 rectangles:\n";
+        std::cout << "\tworld_t: " << world_ns << " ns/ray, " << world_hits << " hits\n";
+        run("packed_world<4>", packed_world<4>{world}, *world, rays, world_ns);
+        if (cpu_supports_avx2()) {
+            run("packed_world<8>", packed_world<8>{world}, *world, rays, world_ns);
+        }
+    }
+    return 0;
+}
@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <array>
+#include <optional>
 
 #include "common.hpp"
 #include "ray.hpp"
@@ -25,26 +26,39 @@ public:
 
     aabb(const point_t &low, const point_t &high) : low_(low), high_(high) {}
 
+    [[nodiscard]] const point_t &low() const { return low_; }
+
+    [[nodiscard]] const point_t &high() const { return high_; }
+
     /**
-     * @brief 包围盒与光线在给定参数范围内是否有交
+     * @brief 包围盒与光线在给定参数范围内求交. 使用光线预先计算的方向倒数与符号直接选取
+     * 先进入与后离开的平面, 没有除法与分支.
+     * 光线平行于某轴且起点恰好在该轴的边界平面上时, 该轴的参数为0 * inf = NaN;
+     * std::max/std::min在第二个参数为NaN时返回第一个参数, 相当于忽略该轴
+     * @return 光线进入包围盒时的参数(不小于tmin), 不相交时返回std::nullopt
      */
-    [[nodiscard]] bool hit(const ray &r, float tmin, float tmax) const {
-        const auto direction = r.direction();
-        const auto origin = r.origin();
+    [[nodiscard]] std::optional<float> entry(const ray &r, float tmin, float tmax) const {
+        const auto &origin = r.origin();
+        const auto &inv_dir = r.inv_direction();
+        const auto &dir_neg = r.dir_neg();
+        const std::array<const point_t *, 2> bounds = {&low_, &high_};
         for (int i = 0; i < 3; i++) {
-            const float invd = 1.0F / direction[i];
-            float t0 = (low_[i] - origin[i]) * invd;
-            float t1 = (high_[i] - origin[i]) * invd;
-            if (invd < 0.0F) {
-                std::swap(t0, t1);
-            }
+            const float t0 = ((*bounds[dir_neg[i]])[i] - origin[i]) * inv_dir[i];
+            const float t1 = ((*bounds[1 - dir_neg[i]])[i] - origin[i]) * inv_dir[i];
             tmin = std::max(tmin, t0);
             tmax = std::min(tmax, t1);
-            if (tmin >= tmax) {
-                return false;
-            }
         }
-        return true;
+        if (tmin >= tmax) {
+            return std::nullopt;
+        }
+        return tmin;
+    }
+
+    /**
+     * @brief 包围盒与光线在给定参数范围内是否有交
+     */
+    [[nodiscard]] bool hit(const ray &r, float tmin, float tmax) const {
+        return entry(r, tmin, tmax).has_value();
     }
 
     /**
@@ -60,6 +74,26 @@ public:
         return {res_low, res_high};
     }
 
+    /**
+     * @brief 计算此包围盒与另一包围盒的交集, 两者不相交时结果为空包围盒
+     */
+    [[nodiscard]] aabb intersect_with(const aabb &other) const {
+        const auto low = other.low_;
+        const auto high = other.high_;
+        const point_t res_low{std::max(low_.x(), low.x()), std::max(low_.y(), low.y()),
+                              std::max(low_.z(), low.z())};
+        const point_t res_high{std::min(high_.x(), high.x()), std::min(high_.y(), high.y()),
+                               std::min(high_.z(), high.z())};
+        return {res_low, res_high};
+    }
+
+    /**
+     * @brief 是否为空包围盒, 默认构造的包围盒为空
+     */
+    [[nodiscard]] bool empty() const {
+        return low_.x() > high_.x() || low_.y() > high_.y() || low_.z() > high_.z();
+    }
+
     [[nodiscard]] point_t centroid() const { return (low_ + high_) / 2.0; }
 
     [[nodiscard]] float area() const {
@@ -0,0 +1,75 @@
+#ifndef RT_AFFINE_HPP
+#define RT_AFFINE_HPP
+
+#include <array>
+
+#include "aabb.hpp"
+#include "common.hpp"
+
+/**
+ * @brief 仿射变换 p' = M * p + t
+ */
+class affine {
+    std::array<vec3_t, 3> rows_;  // 线性部分M, 按行存放
+    vec3_t translation_;          // 平移部分t
+
+public:
+    affine() : rows_{vec3_t{1, 0, 0}, vec3_t{0, 1, 0}, vec3_t{0, 0, 1}} {}
+
+    affine(const std::array<vec3_t, 3> &rows, const vec3_t &translation)
+        : rows_(rows), translation_(translation) {}
+
+    [[nodiscard]] vec3_t apply_vector(const vec3_t &vec) const {
+        return {rows_[0].dot(vec), rows_[1].dot(vec), rows_[2].dot(vec)};
+    }
+
+    [[nodiscard]] point_t apply_point(const point_t &point) const {
+        return apply_vector(point) + translation_;
+    }
+
+    /**
+     * @brief 用线性部分的转置作用于向量; 对逆变换调用时即为法向的变换
+     */
+    [[nodiscard]] vec3_t apply_transposed(const vec3_t &vec) const {
+        return rows_[0] * vec[0] + rows_[1] * vec[1] + rows_[2] * vec[2];
+    }
+
+    /**
+     * @brief 计算变换后包围盒的包围盒(Arvo的方法), 不需要变换全部8个顶点
+     */
+    [[nodiscard]] aabb apply_box(const aabb &box) const {
+        if (box.empty()) {
+            return box;
+        }
+        point_t low = translation_;
+        point_t high = translation_;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                const float coord0 = rows_[i][j] * box.low()[j];
+                const float coord1 = rows_[i][j] * box.high()[j];
+                low[i] += std::min(coord0, coord1);
+                high[i] += std::max(coord0, coord1);
+            }
+        }
+        return {low, high};
+    }
+
+    /**
+     * @brief 逆变换, 线性部分必须可逆
+     */
+    [[nodiscard]] affine inverse() const {
+        // 伴随矩阵的各列是两行的叉积, 除以行列式即得到逆矩阵
+        const auto col0 = rows_[1].cross(rows_[2]);
+        const auto col1 = rows_[2].cross(rows_[0]);
+        const auto col2 = rows_[0].cross(rows_[1]);
+        const float det = rows_[0].dot(col0);
+        std::array<vec3_t, 3> rows;
+        for (int i = 0; i < 3; i++) {
+            rows[i] = vec3_t{col0[i], col1[i], col2[i]} / det;
+        }
+        const affine linear{rows, {0, 0, 0}};
+        return {rows, -linear.apply_vector(translation_)};
+    }
+};
+
+#endif  // RT_AFFINE_HPP
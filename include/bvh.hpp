@@ -5,22 +5,368 @@
 #ifndef RT_BVH_HPP
 #define RT_BVH_HPP
 
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
 #include <memory>
 #include <optional>
+#include <utility>
+#include <vector>
 
 #include "aabb.hpp"
 #include "hittable.hpp"
+#include "leaf_blocks.hpp"
+#include "world.hpp"
+
+/**
+ * @brief 线性化的BVH节点, 按深度优先顺序存放在数组中: 左子节点紧跟在父节点之后
+ */
+struct bvh_node {
+    aabb bounding;
+    // 叶节点: 第一个图元在同类图元中的下标(类型为mixed时是leaf_ranges表中的下标);
+    // 内部节点: 右子节点的下标
+    std::uint32_t offset{0};
+    std::uint16_t count{0};   // 叶节点包含的图元数, 内部节点为0
+    std::uint8_t axis{0};     // 内部节点的划分轴
+    prim_kind kind{prim_kind::triangle};  // 叶节点的图元类型
+
+    [[nodiscard]] bool is_leaf() const { return count > 0; }
+};
+
+static_assert(sizeof(bvh_node) == 32, "bvh_node should fit in half a cache line");
 
 class bvh {
-    std::unique_ptr<bvh> left_, right_;
-    int split_axis_{0};
-    aabb bounding_;
-    std::shared_ptr<hittable> object_;
+public:
+    static constexpr int max_depth = 64;             // 树的最大深度, 决定了遍历栈的大小
+    static constexpr int max_bins = 64;              // SAH分桶数的上限
+    static constexpr int parallel_threshold = 4096;  // 图元数少于此值的子树串行构建
+    static constexpr int max_leaf_size = 64;         // 叶节点图元数的上限
+    static constexpr int treelet_size = 7;           // 重构时每个treelet至多包含的叶节点数
+
+    static constexpr float split_alpha = 1e-5F;      // 尝试空间划分的最小重叠面积(相对根节点)
+
+    enum class builder_type {
+        binned_sah,  // 按图元中心分桶的SAH划分, 每个图元恰好属于一个叶节点
+        spatial,     // SBVH: 允许在空间上切分图元, 同一图元可以被多个叶节点引用
+        linear,      // LBVH: 按图元中心的Morton码排序后直接生成层次结构, 构建最快
+    };
+
+    struct config {
+        builder_type builder{builder_type::binned_sah};
+        int bins{16};              // 每个轴上SAH划分的分桶数
+        int max_leaf_size{4};      // 叶节点最多包含的图元数
+        float cost_ratio{1.0F};    // SAH中求交与遍历一个节点的代价之比
+        float split_budget{0.5F};  // SBVH中新增的图元引用数最多为图元总数的多少倍
+        bool lbvh_sah_top{false};  // LBVH中是否按SAH重建Morton码高位相同的子树之上的层次
+        float rebuild_threshold{1.5F};  // refit后SAH代价超过构建时的多少倍时重新构建
+        int treelet_passes{0};  // 构建完成后按SAH重构treelet的遍数, 为0时不重构
+    };
+
+    /**
+     * @brief 树的质量统计, 用于比较不同的构建算法与参数
+     */
+    struct statistics {
+        std::size_t n_nodes{0};
+        std::size_t n_leaves{0};
+        std::size_t n_prim_refs{0};           // 叶节点引用的图元总数, SBVH中可能多于图元数
+        int max_depth{0};
+        float avg_leaf_depth{0};              // 按叶节点计算的平均深度
+        std::vector<std::size_t> leaf_sizes;  // leaf_sizes[k]为包含k个图元的叶节点数
+        float sah_cost{0};                    // 见sah_cost()
+        float overlap{0};  // 内部节点左右子节点包围盒交集的表面积之和, 以根节点表面积为单位
+        // EPO: 各节点包围盒内不属于其子树的图元表面积(以图元包围盒近似, SBVH中同一图元的其他
+        // 引用也计入), 按节点代价加权后除以全部图元的表面积
+        float epo{0};
+        std::size_t n_mixed_leaves{0};  // 包含多种图元的叶节点数
+        std::size_t memory{0};  // 见bvh::memory_size()
+
+        void print(std::ostream &out) const;
+
+        void write_json(std::ostream &out) const;
+    };
+
+private:
+    /**
+     * @brief 构建过程中使用的图元信息, 预先计算好包围盒与中心, 避免反复调用虚函数.
+     * index是图元在world中的统一下标, 见world_t::locate()
+     */
+    struct prim_info {
+        aabb bounding;
+        point_t centroid;
+        int index;
+    };
+
+    /**
+     * @brief 对象划分时, 中心落在[0, bin]桶内的图元划分到左侧;
+     * 空间划分时, 在第bin个桶的右边界处切开, 跨过边界的图元引用可能同时出现在两侧
+     */
+    struct split {
+        int axis{-1};  // 为-1时表示没有找到有效的划分
+        int bin{0};
+        float cost{0};
+        aabb left;  // 划分后两侧的包围盒与图元引用数
+        aabb right;
+        int n_left{0};
+        int n_right{0};
+    };
+
+    /**
+     * @brief SBVH构建过程中各节点共享的状态
+     */
+    struct spatial_state {
+        const world_t &world;
+        float min_overlap;            // 对象划分两侧的重叠面积超过此值时才尝试空间划分
+        std::size_t budget;           // 还允许新增的图元引用数
+        std::vector<prim_info> refs;  // 按叶节点顺序排列的图元引用
+    };
+
+    config config_;
+    std::vector<bvh_node> nodes_;
+    // 叶节点引用的图元. 构建时各类图元按叶节点顺序原地重排, 与场景及多叉/压缩bvh共享;
+    // SBVH中被多个叶节点引用的图元在重排时被复制
+    std::shared_ptr<world_t> world_{std::make_shared<world_t>()};
+    // prim_indices_[kind][i]: 重排后这一类的第i个图元在重排前的下标, 用于写入缓存与恢复原来的顺序
+    std::array<std::vector<std::uint32_t>, n_prim_kinds> prim_indices_;
+    // 类型为mixed的叶节点中各类图元的范围, 与多叉/压缩bvh共享
+    std::shared_ptr<const std::vector<leaf_ranges>> mixed_{
+        std::make_shared<const std::vector<leaf_ranges>>()};
+    leaf_blocks<4> leaves_;  // 由world_与mixed_构造, 遍历时不必复制shared_ptr
+    float build_cost_{0};  // 构建完成时的SAH代价, 用于判断refit后树的质量是否下降过多
+
+    bvh() = default;
+
+    /**
+     * @brief 在[start, end)范围内用分桶的方式寻找SAH代价最小的划分
+     *
+     * @param bounds 范围内图元中心的包围盒
+     */
+    [[nodiscard]] split find_split(const std::vector<prim_info> &infos, int start, int end,
+                                   const aabb &bounds) const;
+
+    /**
+     * @brief 在图元引用的包围盒bounds内均匀分桶, 寻找SAH代价最小的空间划分.
+     * 跨越多个桶的引用按桶的边界裁剪后再统计, 新增的引用数不超过state.budget
+     */
+    [[nodiscard]] split find_spatial_split(const spatial_state &state,
+                                           const std::vector<prim_info> &refs,
+                                           const aabb &bounds) const;
+
+    /**
+     * @brief 图元数不多时比较SAH代价(以一次节点遍历的代价为单位), 叶节点更划算时返回true
+     *
+     * @param bounds 范围内图元的包围盒
+     */
+    [[nodiscard]] bool prefer_leaf(int span, const aabb &bounds, const split &best) const;
+
+    /**
+     * @brief 划分[start, end)范围内的图元并就地重排, 左侧为[start, mid), 右侧为[mid, end)
+     * @return 划分位置mid与划分轴; 为std::nullopt时此范围应成为叶节点: 只剩一个图元, 或者
+     * allow_leaf为true, 图元数不超过max_leaf_size且按SAH估计叶节点的代价更低
+     */
+    [[nodiscard]] std::optional<std::pair<int, int>> partition(std::vector<prim_info> &infos,
+                                                               int start, int end, int depth,
+                                                               bool allow_leaf = true) const;
+
+    /**
+     * @brief 串行构建[start, end)范围内图元的子树, 节点按深度优先顺序追加到nodes末尾.
+     * 内部节点的offset暂时记为右子节点相对于自身的偏移
+     */
+    void build_serial(std::vector<bvh_node> &nodes, std::vector<prim_info> &infos, int start,
+                      int end, int depth) const;
+
+    // 按深度优先顺序排列的若干节点块, 块内内部节点的offset同样是相对偏移
+    using node_chunks = std::vector<std::vector<bvh_node>>;
+
+    /**
+     * @brief 在左右两棵子树的节点块之前加上以axis为划分轴的父节点, 拼接成一组节点块
+     */
+    [[nodiscard]] static node_chunks join_chunks(std::array<node_chunks, 2> &children, int axis);
+
+    /**
+     * @brief 并行构建子树: 图元数不少于parallel_threshold时并行寻找划分, 并将左右子树作为
+     * 独立的任务交给并行算法的线程池(Linux上为TBB的work-stealing调度器); 否则退化为串行构建
+     */
+    [[nodiscard]] node_chunks build_parallel(std::vector<prim_info> &infos, int start, int end,
+                                             int depth) const;
+
+    struct radix_tree;
+
+    /**
+     * @brief 构建LBVH: infos按Morton码就地排序, 再由基数树生成节点
+     */
+    [[nodiscard]] node_chunks build_linear(std::vector<prim_info> &infos) const;
+
+    /**
+     * @brief 串行地把基数树中以id为根的子树转换为节点, 存放方式与build_serial相同.
+     * 图元数不多且SAH代价更低时整棵子树合并为一个叶节点
+     * @return 子树的SAH代价
+     */
+    float emit_serial(const radix_tree &tree, std::vector<bvh_node> &nodes,
+                      std::vector<prim_info> &infos, std::uint32_t id, int depth) const;
+
+    /**
+     * @brief 并行地转换基数树中以id为根的子树, 左右子树作为独立的任务
+     */
+    [[nodiscard]] node_chunks emit_parallel(const radix_tree &tree, std::vector<prim_info> &infos,
+                                            std::uint32_t id, int depth) const;
+
+    /**
+     * @brief 把[start, end)范围内的子树(treelet)当作图元, 按SAH构建它们之上的层次
+     *
+     * @param treelets 每个子树的包围盒与中心, index为子树的编号
+     */
+    [[nodiscard]] node_chunks emit_upper(const radix_tree &tree, std::vector<prim_info> &infos,
+                                         std::vector<prim_info> &treelets, int start, int end,
+                                         int depth) const;
+
+    /**
+     * @brief 串行构建SBVH子树, 叶节点引用的图元追加到state.refs末尾.
+     * 节点的存放方式与build_serial相同
+     */
+    void build_spatial(spatial_state &state, std::vector<bvh_node> &nodes,
+                       std::vector<prim_info> refs, int depth) const;
+
+    struct linked_tree;
+
+    /**
+     * @brief 以index为根, 取表面积最大的子孙逐个展开, 形成至多treelet_size个叶节点的treelet,
+     * 在其所有二叉拓扑中找出SAH代价最小的一种; 代价确有降低时原地改写treelet的内部节点
+     */
+    void restructure_treelet(linked_tree &tree, std::uint32_t index) const;
+
+    /**
+     * @brief 按Karras与Aila的方法自底向上重构treelet, 共treelet_passes遍.
+     * 同一高度的节点的子树互不相交, 作为一批并行处理; 最后重新按深度优先顺序排列节点
+     */
+    void optimize_treelets();
+
+    /**
+     * @brief 自底向上重新计算以index为根的子树中各节点的包围盒.
+     * 左子树的节点数不少于parallel_threshold时, 左右子树作为两个任务并行计算
+     * @return 子树的包围盒
+     */
+    aabb refit_node(std::uint32_t index);
+
+    /**
+     * @brief 叶节点按深度优先的顺序依次取得各类图元的新位置, 把节点的offset改为同类图元中的
+     * 下标(或leaf_ranges表中的下标), 并按新位置重排world
+     *
+     * @param refs 按叶节点顺序排列的图元引用, 叶节点的offset是其中的下标
+     */
+    void assign_leaves(const std::vector<prim_info> &refs);
+
+    /**
+     * @brief 按prim_indices_原地重排world中的各类图元
+     */
+    void apply_order();
+
+    /**
+     * @brief 把world恢复为构建前的顺序, 去掉SBVH复制的图元
+     */
+    void restore_order();
+
+    /**
+     * @brief 对叶节点中的每一段同类图元调用func(kind, first, count)
+     */
+    template <typename Func>
+    void for_each_range(const bvh_node &leaf, Func &&func) const {
+        if (leaf.kind != prim_kind::mixed) {
+            func(leaf.kind, leaf.offset, (std::uint32_t)leaf.count);
+            return;
+        }
+        const auto &ranges = (*mixed_)[leaf.offset];
+        for (int k = 0; k < n_prim_kinds; k++) {
+            if (ranges.count[k] > 0) {
+                func((prim_kind)k, ranges.first[k], (std::uint32_t)ranges.count[k]);
+            }
+        }
+    }
 
 public:
-    bvh(world_t &world, int start, int end);
+    /**
+     * @brief 构建bvh, 并把world中的各类图元按叶节点顺序原地重排, 不复制场景.
+     * world由调用者(如场景)与bvh共享, 重排后其中的图元顺序改变
+     */
+    bvh(std::shared_ptr<world_t> world, const config &conf);
+
+    /**
+     * @brief 计算缓存文件的键, 不同的几何数据或构建参数对应不同的键
+     *
+     * @param geometry 场景几何数据(包括网格文件的内容与变换)的哈希值
+     */
+    [[nodiscard]] static std::uint64_t cache_key(const config &conf, std::uint64_t geometry);
+
+    /**
+     * @brief 通过内存映射读取缓存文件. 映射只是读取的途径: 节点与图元下标经过检查后复制到
+     * bvh自己的数组中, 返回前即解除映射
+     * @return 文件不存在、已损坏, 或者键与world不匹配时返回std::nullopt, 此时world保持不变;
+     * 读取成功时world与构建时一样按叶节点顺序原地重排
+     */
+    [[nodiscard]] static std::optional<bvh> load(const std::filesystem::path &path,
+                                                 std::uint64_t key,
+                                                 std::shared_ptr<world_t> world,
+                                                 const config &conf);
+
+    /**
+     * @brief 写入缓存文件: 先写临时文件再重命名, 多个进程同时写入时也不会读到残缺的文件
+     * @return 是否写入成功
+     */
+    bool save(const std::filesystem::path &path, std::uint64_t key) const;
+
+    /**
+     * @brief 以根节点的表面积为单位计算整棵树的SAH代价
+     */
+    [[nodiscard]] float sah_cost() const;
+
+    /**
+     * @brief 节点、图元下标与mixed叶节点的范围表占用的字节数; 图元本身是场景的存储, 不计入
+     */
+    [[nodiscard]] std::size_t memory_size() const;
+
+    /**
+     * @brief 遍历整棵树计算质量统计. EPO需要对每个节点在树中查询与之重叠的图元, 耗时较长
+     */
+    [[nodiscard]] statistics stats() const;
+
+    /**
+     * @brief world中的图元原地运动后, 保持树的拓扑不变重新计算所有包围盒.
+     * 叶节点直接引用world中的图元, 不需要重新读取或打包任何数据
+     */
+    void refit();
+
+    /**
+     * @brief 先refit; 若SAH代价超过构建时的rebuild_threshold倍, 则把world恢复为构建前的顺序
+     * 后重新构建
+     * @return 是否重新构建了整棵树
+     */
+    bool update();
+
+    /**
+     * @brief 只求出最近的交点, 不计算着色需要的交点信息
+     */
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const;
+
+    [[nodiscard]] hit_res_t hit(const ray &r, float tmin, float tmax) const {
+        return to_record(r, intersect(r, tmin, tmax));
+    }
+
+    /**
+     * @brief 光线在(tmin, tmax)范围内是否与任一图元相交, 找到第一个交点即返回
+     */
+    [[nodiscard]] bool occluded(const ray &r, float tmin, float tmax) const;
+
+    [[nodiscard]] const std::vector<bvh_node> &nodes() const { return nodes_; }
+
+    [[nodiscard]] const std::shared_ptr<world_t> &world() const { return world_; }
 
-    [[nodiscard]] hit_res_t hit(const ray &r, float tmin, float tmax) const;
+    /**
+     * @brief 与叶节点求交的接口, 多叉/压缩bvh用它与同一组图元求交
+     */
+    template <int Width>
+    [[nodiscard]] leaf_blocks<Width> leaves() const {
+        return {world_, mixed_};
+    }
 };
 
 #endif  // RT_BVH_HPP
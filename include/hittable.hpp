@@ -1,9 +1,9 @@
 #ifndef RT_HITTABLE_HPP
 #define RT_HITTABLE_HPP
 
-#include <memory>
+#include <array>
+#include <cstdint>
 #include <optional>
-#include <vector>
 
 #include "common.hpp"
 
@@ -18,23 +18,69 @@ struct hit_record {
     tex_coords_t tex_coords;         // 交点的曲面参数
     bool outside{true};              // ray来自曲面外还是曲面内;
                                      // 当球半径为负时"曲面外"是包含球心的一侧
-    std::shared_ptr<material> pmat;  // 交点处的材质信息
+    const material *pmat{nullptr};   // 交点处的材质, 不持有所有权, 由场景的材质表保证
+                                     // 在场景存续期间有效; 复制hit_record不会修改引用计数
 };
 
 using hit_res_t = std::optional<hit_record>;
 
+class hittable;
+
+/**
+ * @brief 求交的结果, 只包含交点参数、被击中的图元以及图元自己定义的曲面参数.
+ * 着色需要的交点、法向、纹理坐标与材质等由prim->surface_interaction()只为最近的交点计算一次
+ */
+struct intersection {
+    float ray_param{0};
+    std::array<float, 2> uv{};       // 三角形: 第二、第三个顶点的重心坐标; 矩形: 纹理坐标
+    std::uint32_t face{0};           // prim为网格时被击中的面
+    const hittable *prim{nullptr};   // 负责计算交点信息的图元
+    const hittable *child{nullptr};  // prim为实例时, 底层bvh中被击中的图元
+};
+
+using isect_res_t = std::optional<intersection>;
+
 class hittable {
 public:
     virtual ~hittable() = default;
-    [[nodiscard]] virtual hit_res_t hit(const ray &r, float tmin, float tmax) const = 0;
 
-    [[nodiscard]] virtual aabb bounding_box() const = 0;
-};
+    /**
+     * @brief 计算光线在[tmin, tmax]范围内最近的交点, 只求出交点参数与曲面参数,
+     * 不计算法向、纹理坐标等着色信息
+     */
+    [[nodiscard]] virtual isect_res_t intersect(const ray &r, float tmin, float tmax) const = 0;
 
-using world_t = std::vector<std::shared_ptr<hittable>>;
+    /**
+     * @brief 由intersect()的结果计算完整的交点信息
+     *
+     * @param isect 本图元的intersect()对同一条光线返回的结果
+     */
+    [[nodiscard]] virtual hit_record surface_interaction(const ray &r,
+                                                         const intersection &isect) const = 0;
 
-[[nodiscard]] hit_res_t hit(const world_t &world, const ray &r, float tmin, float tmax);
+    /**
+     * @brief 先求交, 有交点时再计算交点信息
+     */
+    [[nodiscard]] hit_res_t hit(const ray &r, float tmin, float tmax) const;
+
+    /**
+     * @brief 光线在(tmin, tmax)范围内是否被物体遮挡, 用于只关心可见性的查询(如阴影光线).
+     * 找到任意一个交点即可返回; 默认实现直接调用intersect
+     */
+    [[nodiscard]] virtual bool occluded(const ray &r, float tmin, float tmax) const;
+
+    [[nodiscard]] virtual aabb bounding_box() const = 0;
+
+    /**
+     * @brief 计算物体位于axis轴上[low, high]范围内部分的包围盒, 构建SBVH时用于切分图元引用.
+     * 默认直接截取整个包围盒, 子类可以给出更紧的结果; 物体不在此范围内时返回空包围盒
+     */
+    [[nodiscard]] virtual aabb clipped_bounding_box(int axis, float low, float high) const;
+};
 
-[[nodiscard]] aabb bounding_box(const world_t &world, int start, int end);
+/**
+ * @brief 为求交找到的最近交点计算完整的交点信息, 没有交点时返回std::nullopt
+ */
+[[nodiscard]] hit_res_t to_record(const ray &r, const isect_res_t &isect);
 
 #endif  // RT_HITTABLE_HPP
@@ -0,0 +1,61 @@
+#ifndef RT_INSTANCE_HPP
+#define RT_INSTANCE_HPP
+
+#include <memory>
+#include <utility>
+
+#include "aabb.hpp"
+#include "affine.hpp"
+#include "bvh.hpp"
+#include "hittable.hpp"
+#include "ray.hpp"
+
+/**
+ * @brief 物体的一个实例: 多个实例共享同一棵底层bvh, 各自带有从物体空间到世界空间的变换.
+ * 场景的bvh以实例为图元, 构成两层的加速结构
+ */
+class instance : public hittable {
+    std::shared_ptr<const bvh> blas_;  // 物体空间中的底层bvh
+    affine to_world_;
+    affine to_object_;
+    aabb bounding_;  // 世界空间中的包围盒
+
+public:
+    instance(std::shared_ptr<const bvh> blas, const affine &to_world) : blas_(std::move(blas)) {
+        set_transform(to_world);
+    }
+
+    /**
+     * @brief 替换实例的变换, 用于动画中原地更新实例. 调用时不能有其他线程正在与实例求交
+     */
+    void set_transform(const affine &to_world) {
+        to_world_ = to_world;
+        to_object_ = to_world.inverse();
+        if (!blas_->nodes().empty()) {
+            bounding_ = to_world_.apply_box(blas_->nodes().front().bounding);
+        }
+    }
+
+    /**
+     * @brief 把光线变换到物体空间后与底层bvh求交, 结果中的child记录被击中的底层图元
+     */
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const override;
+
+    /**
+     * @brief 由底层图元在物体空间中计算交点信息, 再变换回世界空间
+     */
+    [[nodiscard]] hit_record surface_interaction(const ray &r,
+                                                 const intersection &isect) const override;
+
+    [[nodiscard]] bool occluded(const ray &r, float tmin, float tmax) const override;
+
+    [[nodiscard]] aabb bounding_box() const override { return bounding_; }
+
+private:
+    /**
+     * @brief 世界空间中的光线变换到物体空间, 返回变换后的光线与光线参数的缩放比例
+     */
+    [[nodiscard]] std::pair<ray, float> to_local(const ray &r) const;
+};
+
+#endif  // RT_INSTANCE_HPP
@@ -0,0 +1,102 @@
+#ifndef RT_LEAF_BLOCKS_HPP
+#define RT_LEAF_BLOCKS_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "hittable.hpp"
+#include "world.hpp"
+
+/**
+ * @brief Width个三角形按SoA方式排列, 可以用一次SIMD运算同时与一条光线求交.
+ * 只在求交时由网格的顶点与索引缓冲区临时装入, 不作为存储
+ *
+ * @tparam Width 4对应SSE, 8对应AVX2
+ */
+template <int Width>
+struct alignas(4 * Width) triangle_block {
+    std::array<std::array<float, Width>, 3> vertex0;  // vertex0[axis][lane]: 第一个顶点
+    std::array<std::array<float, Width>, 3> edge1;    // v1 - v0
+    std::array<std::array<float, Width>, 3> edge2;    // v2 - v0
+};
+
+/**
+ * @brief Width个球面按SoA方式排列, 球心的三个分量与半径各占一行. 与triangle_block一样
+ * 只在求交时由world_t::spheres临时装入; 空位的球心为NaN, 有序比较全部不成立, 与任何光线都不相交
+ */
+template <int Width>
+struct alignas(4 * Width) sphere_block {
+    std::array<std::array<float, Width>, 3> center;  // center[axis][lane]
+    std::array<float, Width> radius;
+};
+
+/**
+ * @brief 包含多种图元的叶节点中各类图元在world_t中的范围. 这样的叶节点很少,
+ * 节点本身只记录它在这张表中的下标
+ */
+struct leaf_ranges {
+    std::array<std::uint32_t, n_prim_kinds> first{};
+    std::array<std::uint16_t, n_prim_kinds> count{};
+};
+
+/**
+ * @brief BVH叶节点的求交: 叶节点直接引用world_t中一类图元的一段范围(类型为mixed时是
+ * leaf_ranges表中的一项), 不保存图元的副本. 网格中的面与球面按Width个一组装入
+ * triangle_block与sphere_block批量求交, 矩形直接读取world_t::rectangles求交, 都不调用虚函数;
+ * 其他图元(如实例)通过hittable求交.
+ * 二叉bvh、多叉bvh与压缩bvh的叶节点都可以使用
+ *
+ * @tparam Width 只支持4和8; 8的求交使用AVX2指令, 使用前应检查cpu_supports_avx2()
+ */
+template <int Width>
+class leaf_blocks {
+    static_assert(Width == 4 || Width == 8, "only 4-wide and 8-wide blocks are supported");
+
+    std::shared_ptr<const world_t> world_;
+    std::shared_ptr<const std::vector<leaf_ranges>> mixed_;
+
+public:
+    leaf_blocks()
+        : world_(std::make_shared<const world_t>()),
+          mixed_(std::make_shared<const std::vector<leaf_ranges>>()) {}
+
+    /**
+     * @param world 叶节点引用的图元
+     * @param mixed 类型为mixed的叶节点中各类图元的范围
+     */
+    leaf_blocks(std::shared_ptr<const world_t> world,
+                std::shared_ptr<const std::vector<leaf_ranges>> mixed)
+        : world_(std::move(world)), mixed_(std::move(mixed)) {}
+
+    /**
+     * @brief 与叶节点中的全部图元求交, 返回[tmin, tmax]内最近的交点
+     *
+     * @param kind, offset, count 叶节点的类型、第一个图元的下标(或在leaf_ranges表中的下标)
+     * 与图元数
+     */
+    [[nodiscard]] isect_res_t intersect(prim_kind kind, std::uint32_t offset,
+                                        std::uint32_t count, const ray &r, float tmin,
+                                        float tmax) const;
+
+    /**
+     * @brief 叶节点中是否有图元在(tmin, tmax)范围内遮挡光线
+     */
+    [[nodiscard]] bool occluded(prim_kind kind, std::uint32_t offset, std::uint32_t count,
+                                const ray &r, float tmin, float tmax) const;
+};
+
+// 8宽叶节点的求交按AVX2单独编译
+template <>
+isect_res_t leaf_blocks<8>::intersect(prim_kind kind, std::uint32_t offset, std::uint32_t count,
+                                      const ray &r, float tmin, float tmax) const;
+
+template <>
+bool leaf_blocks<8>::occluded(prim_kind kind, std::uint32_t offset, std::uint32_t count,
+                              const ray &r, float tmin, float tmax) const;
+
+extern template class leaf_blocks<4>;
+extern template class leaf_blocks<8>;
+
+#endif  // RT_LEAF_BLOCKS_HPP
@@ -0,0 +1,36 @@
+#ifndef RT_MAPPED_FILE_HPP
+#define RT_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <filesystem>
+
+/**
+ * @brief 以只读方式映射到内存中的文件, 析构时解除映射
+ */
+class mapped_file {
+    const char *data_{nullptr};
+    std::size_t size_{0};
+#ifdef _WIN32
+    void *file_{nullptr};     // 文件句柄
+    void *mapping_{nullptr};  // 文件映射对象的句柄
+#endif
+
+public:
+    /**
+     * @brief 映射整个文件; 文件不存在、为空或映射失败时is_open()为false
+     */
+    explicit mapped_file(const std::filesystem::path &path);
+
+    ~mapped_file();
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    [[nodiscard]] bool is_open() const { return data_ != nullptr; }
+
+    [[nodiscard]] const char *data() const { return data_; }
+
+    [[nodiscard]] std::size_t size() const { return size_; }
+};
+
+#endif  // RT_MAPPED_FILE_HPP
@@ -0,0 +1,45 @@
+#ifndef RT_PACKED_WORLD_HPP
+#define RT_PACKED_WORLD_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+#include "hittable.hpp"
+#include "leaf_blocks.hpp"
+#include "world.hpp"
+
+/**
+ * @brief 不使用bvh时的场景: 每一类图元按原有顺序每group_size个一组, 各组像bvh的叶节点一样
+ * 通过leaf_blocks求交, 网格中的面用SIMD块批量求交, 不复制任何图元
+ *
+ * @tparam Width 只支持4和8; 8的求交使用AVX2指令, 使用前应检查cpu_supports_avx2()
+ */
+template <int Width>
+class packed_world {
+public:
+    static constexpr std::uint32_t group_size = 64;
+
+private:
+    std::array<std::uint32_t, n_prim_kinds> n_prims_{};  // 各类图元的个数
+    leaf_blocks<Width> leaves_;
+
+public:
+    explicit packed_world(std::shared_ptr<const world_t> world);
+
+    /**
+     * @brief 只求出最近的交点, 不计算着色需要的交点信息
+     */
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const;
+
+    [[nodiscard]] hit_res_t hit(const ray &r, float tmin, float tmax) const {
+        return to_record(r, intersect(r, tmin, tmax));
+    }
+
+    [[nodiscard]] bool occluded(const ray &r, float tmin, float tmax) const;
+};
+
+extern template class packed_world<4>;
+extern template class packed_world<8>;
+
+#endif  // RT_PACKED_WORLD_HPP
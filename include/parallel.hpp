@@ -0,0 +1,38 @@
+#ifndef RT_PARALLEL_HPP
+#define RT_PARALLEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <execution>
+
+// 与xmake.lua一致, 只在Linux上链接TBB; 其他平台(如MSVC)退回标准库的并行算法
+#if defined(__linux__) && __has_include(<tbb/task_group.h>)
+#define RT_HAS_TBB
+#include <tbb/task_group.h>
+#endif
+
+/**
+ * @brief 并行执行两个互不依赖的任务并等待两者完成, 用于递归地处理左右子树.
+ * 使用tbb::task_group时一个任务交给工作窃取调度, 另一个在当前线程执行, 递归的每一层不必
+ * 为只有两个元素的范围启动一次并行算法
+ */
+template <typename First, typename Second>
+void fork_join(const First &first, const Second &second) {
+#ifdef RT_HAS_TBB
+    tbb::task_group group;
+    group.run(first);
+    second();
+    group.wait();
+#else
+    const std::array<int, 2> tasks = {0, 1};
+    std::for_each(std::execution::par, tasks.begin(), tasks.end(), [&](int task) {
+        if (task == 0) {
+            first();
+        } else {
+            second();
+        }
+    });
+#endif
+}
+
+#endif  // RT_PARALLEL_HPP
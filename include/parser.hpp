@@ -1,21 +1,28 @@
 #ifndef RT_PARSER_HPP
 #define RT_PARSER_HPP
 
+#include <array>
 #include <filesystem>
 #include <functional>
 #include <memory>
 #include <unordered_map>
+#include <utility>
 
+#include "bvh.hpp"
 #include "hittable.hpp"
+#include "scene.hpp"
 #include "toml.hpp"
+#include "triangle_mesh.hpp"
 #include "utils.hpp"
 
+class affine;
 class material;
 class texture;
 class tracer;
 
 class parser {
     std::filesystem::path scene_path_;  // 配置文件的(绝对)路径
+    toml::table config_;                // 配置文件只解析一次
 
     // 用于对mesh作几何变换
     struct transf {
@@ -33,19 +40,46 @@ class parser {
      */
     static std::vector<float> parse_vec(const toml::array &arr, int start, int cnt);
 
+    /**
+     * @brief 从OBJ文件读取出的带索引的网格, 顶点位于物体空间.
+     * OBJ中位置与纹理坐标下标相同的顶点只保存一次
+     */
+    struct mesh_data {
+        using face_t = triangle_mesh::face_t;
+        std::vector<point_t> vertices;
+        std::vector<tex_coords_t> tex_coords;  // 与vertices一一对应
+        std::vector<face_t> faces;
+        std::vector<std::uint32_t> mat_ids;  // 各面的材质在materials中的下标
+        std::vector<const material *> materials;  // 由场景的材质表持有
+    };
+
+    /**
+     * @brief 计算网格模型的"中心"以及网格点到中心的最远距离
+     */
+    static std::pair<point_t, float> mesh_extent(const std::vector<point_t> &vertices);
+
+    /**
+     * @brief 计算把网格从物体空间变换到世界空间的仿射变换
+     *
+     * @param extent 网格的中心与半径, 由mesh_extent得到
+     * @param trans 几何变换定义
+     */
+    static affine mesh_transform(const std::pair<point_t, float> &extent, const transf &trans);
+
     /**
      * @brief 对一个网格模型作几何变换
      *
      * @param vertices 网格点
      * @param trans 几何变换定义
      */
-    static void transform_mesh(std::vector<point_t> &vertices, transf &trans);
+    static void transform_mesh(std::vector<point_t> &vertices, const transf &trans);
 
     using tex_tbl_t = std::unordered_map<std::string, std::shared_ptr<texture>>;
     [[nodiscard]] tex_tbl_t read_textures() const;
 
-    using mat_tbl_t = std::unordered_map<std::string, std::shared_ptr<material>>;
-    [[nodiscard]] mat_tbl_t read_materials(const tex_tbl_t &tex_tbl) const;
+    // 材质本身交给场景持有, 表中只记录名字对应的材质
+    using mat_tbl_t = std::unordered_map<std::string, const material *>;
+    [[nodiscard]] mat_tbl_t read_materials(const tex_tbl_t &tex_tbl, scene &world) const;
 
     /**
      * @brief 单个物体(如球/矩形/mesh)是由一个toml数组定义的, 同一类物体位于一个toml数组内.
@@ -57,13 +91,68 @@ class parser {
     void read_objects(const char *name,
                       const std::function<void(const toml::array &info)> &single_parser) const;
 
+    /**
+     * @brief 读取一个OBJ网格文件及其材质
+     *
+     * @param mesh_info 场景配置中定义该网格的toml数组
+     * @param world OBJ文件中定义的材质交给它持有
+     */
+    [[nodiscard]] static mesh_data read_mesh(const std::filesystem::path &mesh_path,
+                                             const toml::array &mesh_info,
+                                             const mat_tbl_t &mat_tbl, scene &world);
+
+    /**
+     * @brief 由网格数据构造triangle_mesh
+     */
+    [[nodiscard]] static triangle_mesh make_mesh(mesh_data mesh);
+
+    /**
+     * @brief 从配置的options表中读取bvh的构建参数, 未指定的参数使用默认值
+     */
+    [[nodiscard]] static bvh::config read_bvh_config(const toml::table &config);
+
+    /**
+     * @brief 计算场景中所有几何物体的哈希值, 包括各物体的定义、动画参数以及网格文件的内容,
+     * 用作bvh缓存的键. 缓存只保存动画第一帧的bvh, 之后的帧不读写缓存.
+     * 材质等不影响bvh的内容不参与计算
+     */
+    [[nodiscard]] std::uint64_t geometry_hash() const;
+
+    /**
+     * @brief bvh缓存文件的路径: 缓存目录相对于场景文件所在的目录, 文件名是键的16位十六进制表示
+     */
+    [[nodiscard]] std::filesystem::path bvh_cache_path(const std::string &cache_dir,
+                                                       std::uint64_t key) const;
+
+    /**
+     * @brief 构建实例化网格的底层bvh. 指定了缓存目录时与顶层bvh共用该目录, 键由网格文件的内容
+     * 与材质设置决定, 与实例的变换无关
+     *
+     * @param mesh_world 只包含该网格的图元, 与顶层bvh一样按叶节点顺序原地重排
+     * @param material 网格使用的材质设置, 参与缓存键的计算
+     */
+    [[nodiscard]] std::shared_ptr<const bvh> make_blas(std::shared_ptr<world_t> mesh_world,
+                                                       const std::filesystem::path &mesh_path,
+                                                       const std::string &material,
+                                                       const bvh::config &bvh_conf) const;
+
 public:
     explicit parser(const std::string &file) : scene_path_(file) {
         scene_path_ = std::filesystem::absolute(scene_path_);
         exist_or_abort(scene_path_, "scene config file");
+        config_ = toml::parse_file(scene_path_.string());
     }
 
-    [[nodiscard]] world_t make_scene() const;
+    /**
+     * @brief 动画的总帧数, 未定义动画时为1
+     */
+    [[nodiscard]] int frame_count() const;
+
+    /**
+     * @brief 读取场景中的纹理、材质与全部物体. 定义了动画时网格随帧运动,
+     * 由scene::frame()得到各帧的图元, 不需要重新读取
+     */
+    [[nodiscard]] scene make_scene() const;
 
     [[nodiscard]] tracer make_tracer() const;
 };
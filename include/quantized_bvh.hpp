@@ -0,0 +1,75 @@
+#ifndef RT_QUANTIZED_BVH_HPP
+#define RT_QUANTIZED_BVH_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "aabb.hpp"
+#include "bvh.hpp"
+#include "hittable.hpp"
+
+/**
+ * @brief 压缩的BVH内部节点: 两个子节点的包围盒以父节点包围盒为基准量化为8位整数.
+ * 父包围盒每个轴等分为255份, 子包围盒的低端记为距父包围盒低端的份数(向下取整),
+ * 高端记为距父包围盒高端的份数(同样向外取整), 解码得到的包围盒总是包含原包围盒
+ */
+struct quantized_bvh_node {
+    std::array<std::array<std::uint8_t, 6>, 2> boxes;  // boxes[child]: 低端xyz, 高端xyz
+    std::array<std::uint32_t, 2> children;  // 子节点下标; 叶子时与bvh_node::offset相同
+    std::array<std::uint8_t, 2> counts;     // 叶子包含的图元数, 内部节点为0
+    std::uint8_t axis{0};                   // 划分轴
+    std::uint8_t kinds{0};                  // 两个叶子的图元类型, 各占4位
+
+    [[nodiscard]] prim_kind kind(int child) const {
+        return (prim_kind)((kinds >> (4 * child)) & 0xF);
+    }
+};
+
+static_assert(sizeof(quantized_bvh_node) == 24, "quantized node should stay within 24 bytes");
+static_assert(bvh::max_leaf_size <= UINT8_MAX, "leaf size must fit in quantized_bvh_node");
+
+/**
+ * @brief 由二叉bvh压缩得到的BVH, 只有根节点的包围盒以全精度保存.
+ * 遍历时沿途解码子节点的包围盒, 以少量计算换取约为二叉bvh三分之一的节点内存
+ */
+class quantized_bvh {
+    std::vector<quantized_bvh_node> nodes_;
+    aabb bounds_;                   // 根节点的包围盒
+    std::uint32_t root_offset_{0};  // 根节点本身是叶子时, 第一个图元的下标
+    std::uint8_t root_count_{0};    // 根节点本身是叶子时包含的图元数, 否则为0
+    prim_kind root_kind_{prim_kind::triangle};  // 根节点本身是叶子时的图元类型
+    leaf_blocks<4> leaves_;                     // 与二叉bvh引用同一组图元
+
+    /**
+     * @brief 压缩二叉树中以index为根的子树, 节点按深度优先顺序追加到nodes_末尾
+     *
+     * @param decoded 由父节点解码得到的index的包围盒
+     * @return 子树根节点的下标
+     */
+    std::uint32_t compress(const std::vector<bvh_node> &binary, std::uint32_t index,
+                           const aabb &decoded);
+
+public:
+    explicit quantized_bvh(const bvh &binary);
+
+    /**
+     * @brief 只求出最近的交点, 不计算着色需要的交点信息
+     */
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const;
+
+    [[nodiscard]] hit_res_t hit(const ray &r, float tmin, float tmax) const {
+        return to_record(r, intersect(r, tmin, tmax));
+    }
+
+    [[nodiscard]] bool occluded(const ray &r, float tmin, float tmax) const;
+
+    /**
+     * @brief 节点占用的内存字节数
+     */
+    [[nodiscard]] std::size_t memory_size() const {
+        return nodes_.size() * sizeof(quantized_bvh_node);
+    }
+};
+
+#endif  // RT_QUANTIZED_BVH_HPP
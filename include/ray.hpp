@@ -1,20 +1,39 @@
 #ifndef RT_RAY_H
 #define RT_RAY_H
 
+#include <array>
+
 #include "common.hpp"
 
 class ray {
 private:
     point_t origin_;
     unit_vec3 direction_;
+    vec3_t inv_direction_;                 // 各分量为1 / direction_, 分量为0时是带符号的无穷大
+    std::array<int, 3> dir_neg_{0, 0, 0};  // 各轴上方向是否为负(按inv_direction_的符号), 0或1
 
 public:
-    [[nodiscard]] point_t origin() const { return origin_; }
+    [[nodiscard]] const point_t &origin() const { return origin_; }
+
+    [[nodiscard]] const unit_vec3 &direction() const { return direction_; }
+
+    /**
+     * @brief 预先计算的方向倒数, 包围盒求交时不需要对每个节点重复做除法
+     */
+    [[nodiscard]] const vec3_t &inv_direction() const { return inv_direction_; }
 
-    [[nodiscard]] unit_vec3 direction() const { return direction_; }
+    /**
+     * @brief 方向在各轴上的符号, 用作{low, high}的下标即可直接取得先进入的平面
+     */
+    [[nodiscard]] const std::array<int, 3> &dir_neg() const { return dir_neg_; }
 
     ray() = default;
-    ray(const point_t &origin, const vec3_t &direction) : origin_(origin), direction_(direction) {}
+    ray(const point_t &origin, const vec3_t &direction) : origin_(origin), direction_(direction) {
+        for (int i = 0; i < 3; i++) {
+            inv_direction_[i] = 1.0F / direction_[i];
+            dir_neg_[i] = inv_direction_[i] < 0 ? 1 : 0;
+        }
+    }
 
     [[nodiscard]] point_t point_at(float t) const { return origin_ + t * direction_; }
 };
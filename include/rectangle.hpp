@@ -5,17 +5,26 @@
 
 #include "hittable.hpp"
 
+/**
+ * @brief 计算光线在[tmin, tmax]范围内与矩形(corner, corner + edge_u, corner + edge_v)交点的参数,
+ * 同时输出交点的纹理坐标; normal为两条边的单位法向, 两条边必须相互垂直
+ */
+[[nodiscard]] std::optional<float> intersect_rectangle(const ray &r, const point_t &corner,
+                                                       const vec3_t &edge_u, const vec3_t &edge_v,
+                                                       const unit_vec3 &normal, float tmin,
+                                                       float tmax, tex_coords_t &tex_coords);
+
 class rectangle : public hittable {
     point_t corner_;
     vec3_t edge_u_;
     vec3_t edge_v_;
     unit_vec3 normal_;
-    std::shared_ptr<material> pmat_;
+    const material *pmat_;  // 由场景的材质表持有
 
 public:
     rectangle(const point_t &p, const vec3_t &edgeu, const vec3_t &edgev,
-              std::shared_ptr<material> pmat)
-        : corner_(p), edge_u_(edgeu), edge_v_(edgev), pmat_(std::move(pmat)) {
+              const material *pmat)
+        : corner_(p), edge_u_(edgeu), edge_v_(edgev), pmat_(pmat) {
         normal_ = edgeu.cross(edgev).normalized();
         if (normal_.len_sq() == 0) {
             std::cerr << "bad rectangle: collinear edge\n";
@@ -23,7 +32,23 @@ public:
         edge_v_ = normal_.cross(edge_u_);
     }
 
-    [[nodiscard]] hit_res_t hit(const ray &r, float tmin, float tmax) const override;
+    /**
+     * @brief 计算光线在[tmin, tmax]范围内与矩形交点的参数, 交点的曲面参数即纹理坐标,
+     * 保存在intersection::uv中
+     */
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const override;
+
+    [[nodiscard]] hit_record surface_interaction(const ray &r,
+                                                 const intersection &isect) const override;
+
+    // 求交使用的数据: 一个顶点, 由它出发的两条相互垂直的边与单位法向
+    [[nodiscard]] const point_t &corner() const { return corner_; }
+
+    [[nodiscard]] const vec3_t &edge_u() const { return edge_u_; }
+
+    [[nodiscard]] const vec3_t &edge_v() const { return edge_v_; }
+
+    [[nodiscard]] const unit_vec3 &normal() const { return normal_; }
 
     [[nodiscard]] aabb bounding_box() const override;
 };
@@ -0,0 +1,91 @@
+#ifndef RT_SCENE_HPP
+#define RT_SCENE_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "affine.hpp"
+#include "hittable.hpp"
+#include "material.hpp"
+#include "world.hpp"
+
+class instance;
+
+/**
+ * @brief 读取完成的场景, 拥有全部图元与材质. 动画的各帧共用同一组图元: 场景文件、纹理与网格文件
+ * 只在读取时处理一次, 之后每一帧只原地更新运动的网格的顶点与实例的变换.
+ * 图元只以裸指针引用材质, 求交时复制hit_record不需要修改引用计数; 场景销毁后不能再使用它的图元
+ */
+class scene {
+public:
+    // 第frame帧中从物体空间到世界空间的变换
+    using transform_fn = std::function<affine(int frame)>;
+
+private:
+    struct animated_mesh {
+        std::uint32_t first_vertex;      // 在场景网格中的第一个顶点
+        std::vector<point_t> positions;  // 物体空间中的顶点
+        transform_fn transform;
+    };
+
+    struct animated_instance {
+        std::shared_ptr<instance> object;
+        transform_fn transform;
+    };
+
+    std::shared_ptr<world_t> world_{std::make_shared<world_t>()};
+    std::vector<std::unique_ptr<material>> materials_;
+    std::vector<animated_mesh> meshes_;
+    std::vector<animated_instance> instances_;
+
+public:
+    /**
+     * @brief 把材质交给场景持有, 返回的指针在场景存续期间有效
+     */
+    const material *add_material(std::unique_ptr<material> mat) {
+        materials_.push_back(std::move(mat));
+        return materials_.back().get();
+    }
+
+    /**
+     * @brief 加入不随动画运动的图元
+     */
+    void add(std::shared_ptr<hittable> object) { world_->objects.push_back(std::move(object)); }
+
+    /**
+     * @brief 加入球面, 按值存放在场景的球面数组中
+     */
+    void add(const sphere &ball) { world_->spheres.push_back(ball); }
+
+    /**
+     * @brief 加入矩形, 按值存放在场景的矩形数组中
+     */
+    void add(const rectangle &rect) { world_->rectangles.push_back(rect); }
+
+    /**
+     * @brief 加入不随动画运动的网格, 网格的顶点与面追加到场景的网格中
+     */
+    void add(const triangle_mesh &mesh) { world_->mesh.append(mesh); }
+
+    /**
+     * @brief 加入随动画运动的网格, 网格的顶点与面追加到场景的网格中.
+     * mesh的顶点位于物体空间, 每一帧由transform变换到世界空间
+     */
+    void add_animated(const triangle_mesh &mesh, transform_fn transform);
+
+    /**
+     * @brief 加入随动画运动的实例, 每一帧的变换由transform给出
+     */
+    void add_animated(std::shared_ptr<instance> object, transform_fn transform);
+
+    /**
+     * @brief 把运动的网格与实例更新到第frame帧, 返回场景的全部图元.
+     * 各帧返回同一个world, 其中的图元被原地修改, 引用它的bvh可以直接refit.
+     * 调用时不能有其他线程正在与场景求交
+     */
+    [[nodiscard]] std::shared_ptr<world_t> frame(int frame);
+};
+
+#endif  // RT_SCENE_HPP
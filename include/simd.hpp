@@ -0,0 +1,22 @@
+#ifndef RT_SIMD_HPP
+#define RT_SIMD_HPP
+
+// x86-64上总是可以使用SSE
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define RT_SIMD_SSE
+#include <immintrin.h>
+#endif
+
+// 使用AVX2的函数单独按AVX2编译, 其余代码不依赖AVX2, 因此同一个可执行文件可以在旧CPU上运行;
+// 调用之前应检查cpu_supports_avx2()
+#if defined(RT_SIMD_SSE) && (defined(__GNUC__) || defined(__clang__))
+#define RT_SIMD_AVX2
+#define RT_TARGET_AVX2 __attribute__((target("avx2")))
+#define RT_FLATTEN __attribute__((flatten))
+#elif defined(RT_SIMD_SSE) && defined(_MSC_VER)
+#define RT_SIMD_AVX2
+#define RT_TARGET_AVX2
+#define RT_FLATTEN
+#endif
+
+#endif  // RT_SIMD_HPP
@@ -9,10 +9,16 @@
 
 class material;
 
+/**
+ * @brief 计算光线在[tmin, tmax]范围内与球面(center, radius)最近交点的参数
+ */
+[[nodiscard]] std::optional<float> intersect_sphere(const ray &r, const point_t &center,
+                                                    float radius, float tmin, float tmax);
+
 class sphere : public hittable {
     point_t center_;
     float radius_;
-    std::shared_ptr<material> pmat_;
+    const material *pmat_;  // 由场景的材质表持有
 
 private:
     /**
@@ -21,10 +27,21 @@ private:
     [[nodiscard]] tex_coords_t uv_at(const point_t &point) const;
 
 public:
-    sphere(const point_t &center, float radius, std::shared_ptr<material> m)
-        : center_(center), radius_(radius), pmat_(std::move(m)) {}
+    sphere(const point_t &center, float radius, const material *m)
+        : center_(center), radius_(radius), pmat_(m) {}
+
+    /**
+     * @brief 计算光线在[tmin, tmax]范围内与球面最近交点的参数, 交点、法向与参数坐标
+     * 留到surface_interaction()中计算
+     */
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const override;
+
+    [[nodiscard]] hit_record surface_interaction(const ray &r,
+                                                 const intersection &isect) const override;
+
+    [[nodiscard]] const point_t &center() const { return center_; }
 
-    [[nodiscard]] hit_res_t hit(const ray &r, float tmin, float tmax) const override;
+    [[nodiscard]] float radius() const { return radius_; }
 
     [[nodiscard]] aabb bounding_box() const override {
         const float absr = std::abs(radius_);
@@ -4,6 +4,7 @@
 #include <cmath>
 #include <cstdlib>
 #include <execution>
+#include <fstream>
 #include <iostream>
 #include <numeric>
 #include <string>
@@ -14,7 +15,11 @@
 #include "common.hpp"
 #include "hittable.hpp"
 #include "material.hpp"
+#include "packed_world.hpp"
+#include "quantized_bvh.hpp"
 #include "stb_image_write.h"
+#include "wide_bvh.hpp"
+#include "world.hpp"
 
 class tracer {
 public:
@@ -23,6 +28,14 @@ public:
         int samples_per_pixel;
         int max_depth;
         bool use_bvh, parallel;
+        bvh::config bvh_conf;
+        int bvh_width;             // 2: 二叉bvh; 4/8: 由二叉bvh折叠得到的bvh4/bvh8
+        std::string bvh_cache;     // bvh缓存文件的路径, 为空时不使用缓存
+        std::uint64_t bvh_key{0};  // 缓存文件的键, 由场景几何与构建参数决定
+        bool bvh_quantized{false};  // 是否把二叉bvh压缩为quantized_bvh, 此时忽略bvh_width
+        bool bvh_report{false};       // 构建完成后是否输出bvh的质量统计
+        std::string bvh_report_json;  // 质量统计另外以JSON格式写入的文件路径, 为空时不写入
+        int frames{1};                // 要渲染的帧数, 决定压缩后能否释放二叉bvh
     };
 
     tracer(const config &conf, const camera &cam, std::unique_ptr<texture> envlight)
@@ -33,6 +46,8 @@ private:
     camera cam_;
     std::vector<unsigned char> data_;
     std::unique_ptr<texture> envlight_;
+    std::optional<bvh> binary_;  // 上一帧使用的二叉bvh, 之后的帧在它的基础上refit
+    int frame_{0};               // 已经渲染的帧数
 
     /**
      * @brief 写入一个像素, 图像左上角为起点
@@ -50,7 +65,7 @@ private:
     /**
      * @brief 向场景中"发射"一条光线, 追踪其反射/折射, 并计算光线的颜色
      *
-     * @tparam T 场景聚合体的类型, 必须是: world_t 或 bvh
+     * @tparam T 场景聚合体的类型, 必须是: world_t, packed_world, bvh, bvh4, bvh8 或 quantized_bvh
      * @param r 光线定义
      * @param target 场景聚合体
      * @param depth 递归深度, 为0时退出递归
@@ -63,7 +78,9 @@ private:
         }
         hit_res_t record = std::nullopt;
         constexpr float ray_nearest_t = 0.001F;
-        if constexpr (std::is_same_v<T, bvh>) {
+        if constexpr (std::is_same_v<T, bvh> || std::is_same_v<T, bvh4> ||
+                      std::is_same_v<T, bvh8> || std::is_same_v<T, quantized_bvh> ||
+                      std::is_same_v<T, packed_world<4>> || std::is_same_v<T, packed_world<8>>) {
             record = target.hit(r, ray_nearest_t, g_max);
         } else if constexpr (std::is_same_v<T, world_t>) {
             record = hit(target, r, ray_nearest_t, g_max);
@@ -92,7 +109,7 @@ private:
     /**
      * @brief 采样图片中的单个像素、渲染并写入颜色值
      *
-     * @tparam T 场景聚合体的类型, 必须是: world_t 或 bvh
+     * @tparam T 场景聚合体的类型, 必须是: world_t, packed_world, bvh, bvh4, bvh8 或 quantized_bvh
      * @param target 场景聚合体
      * @param row 像素所在行, 从上到下
      * @param col 像素所在列, 从左到右
@@ -111,10 +128,35 @@ private:
         write_color(row, col, color);
     }
 
+    /**
+     * @brief 优先从缓存文件读取二叉bvh; 缓存不可用时重新构建, 并写入缓存文件.
+     * 缓存的键只由场景文件决定, 对应动画的第一帧, 因此只在第一帧读写缓存; 之后的帧refit这棵树.
+     * world与bvh共享, 其中的图元按叶节点顺序原地重排
+     */
+    [[nodiscard]] bvh make_bvh(std::shared_ptr<world_t> world) const {
+        const bool use_cache = !config_.bvh_cache.empty() && frame_ == 0;
+        if (use_cache) {
+            auto cached = bvh::load(config_.bvh_cache, config_.bvh_key, world, config_.bvh_conf);
+            if (cached.has_value()) {
+                std::cout << "\tloaded from cache " << config_.bvh_cache << "\n";
+                return std::move(cached.value());
+            }
+        }
+        bvh tree{world, config_.bvh_conf};
+        if (use_cache) {
+            if (tree.save(config_.bvh_cache, config_.bvh_key)) {
+                std::cout << "\tsaved to cache " << config_.bvh_cache << "\n";
+            } else {
+                std::cerr << "failed to write bvh cache " << config_.bvh_cache << "\n";
+            }
+        }
+        return tree;
+    }
+
     /**
      * @brief 通过模板统一是否使用BVH的两种情形; 内部条件判断统一是否使用多核算法
      *
-     * @tparam T 场景聚合体的类型, 必须是: world_t 或 bvh
+     * @tparam T 场景聚合体的类型, 必须是: world_t, packed_world, bvh, bvh4, bvh8 或 quantized_bvh
      * @param target 场景聚合体
      * @param path 图片文件的保存路径
      */
@@ -149,24 +191,85 @@ private:
 
 public:
     /**
-     * @brief 渲染场景, 将结果保存到图片文件中
+     * @brief 渲染场景, 将结果保存到图片文件中. 多次调用时(如渲染动画的各帧)传入同一个world,
+     * 之后的调用会refit第一次构建的bvh而不是重新构建
      *
-     * @param world 场景定义, 由一系列基本元素组成
+     * @param world 场景定义, 由一系列基本元素组成; 使用bvh时其中的图元被原地重排, 不复制
      * @param path 图片文件的保存路径
      */
-    void trace(const world_t &world, const std::string &path) {
+    void trace(const std::shared_ptr<world_t> &world, const std::string &path) {
         if (config_.use_bvh) {
             std::cout << "BVH building: started...\n";
             auto start = std::chrono::steady_clock::now();
-            world_t world_cp = world;
-            bvh bvh{world_cp, 0, (int)world_cp.size()};
+            if (!binary_.has_value() || binary_->world() != world) {
+                binary_.emplace(make_bvh(world));
+            } else if (binary_->update()) {
+                std::cout << "\trefit degraded the SAH cost too much, rebuilt\n";
+            } else {
+                std::cout << "\trefitted the previous BVH\n";
+            }
+            int width = config_.bvh_width;
+            if (width == 8 && !cpu_supports_avx2()) {
+                std::cout << "\tAVX2 is not supported by this CPU, falling back to binary BVH\n";
+                width = 2;
+            }
+            std::optional<bvh4> tree4;
+            std::optional<bvh8> tree8;
+            std::optional<quantized_bvh> quantized;
+            if (config_.bvh_quantized) {
+                // 压缩时二叉bvh与压缩后的节点同时存在, 这才是这条路径的内存峰值
+                quantized.emplace(binary_.value());
+                const auto quantized_bytes = quantized->memory_size();
+                const auto binary_bytes = binary_->memory_size();
+                std::cout << "\tquantized nodes: " << quantized_bytes / 1024
+                          << " KiB, binary BVH: " << binary_bytes / 1024
+                          << " KiB, peak: " << (quantized_bytes + binary_bytes) / 1024
+                          << " KiB\n";
+            } else if (width == 4) {
+                tree4.emplace(binary_.value());
+            } else if (width == 8) {
+                tree8.emplace(binary_.value());
+            }
             auto end = std::chrono::steady_clock::now();
             std::cout << "BVH building: done in "
                       << std::chrono::duration<double>(end - start).count() << "s.\n\n";
-            trace_unified(bvh, path);
+            // 质量统计(尤其是EPO)耗时较长, 不计入构建时间
+            if (config_.bvh_report) {
+                const auto report = binary_->stats();
+                report.print(std::cout);
+                if (!config_.bvh_report_json.empty()) {
+                    std::ofstream json{config_.bvh_report_json};
+                    report.write_json(json);
+                    if (!json) {
+                        std::cerr << "failed to write bvh report " << config_.bvh_report_json
+                                  << "\n";
+                    }
+                }
+            }
+            // 动画的下一帧要在二叉bvh的基础上refit, 只有最后一帧才能释放它以节省内存
+            if (quantized.has_value() && frame_ + 1 >= config_.frames) {
+                binary_.reset();
+                std::cout << "\treleased the binary BVH, rendering with "
+                          << quantized->memory_size() / 1024 << " KiB of quantized nodes\n";
+            } else if (quantized.has_value()) {
+                std::cout << "\tkept the binary BVH for refitting the next frame\n";
+            }
+            if (quantized.has_value()) {
+                trace_unified(quantized.value(), path);
+            } else if (tree4.has_value()) {
+                trace_unified(tree4.value(), path);
+            } else if (tree8.has_value()) {
+                trace_unified(tree8.value(), path);
+            } else {
+                trace_unified(binary_.value(), path);
+            }
+        } else if (cpu_supports_avx2()) {
+            // 不使用bvh时网格中的面同样按SIMD块批量求交
+            trace_unified(packed_world<8>{world}, path);
         } else {
-            trace_unified(world, path);
+            trace_unified(packed_world<4>{world}, path);
         }
+        frame_++;
     }
 };
 
@@ -4,38 +4,73 @@
 #include <array>
 #include <iostream>
 
+#include "aabb.hpp"
 #include "hittable.hpp"
 
+/**
+ * @brief Möller–Trumbore算法: 计算光线在[tmin, tmax]范围内与三角形(v0, v0 + edge1, v0 + edge2)
+ * 交点的参数, 同时输出交点的重心坐标, 不需要开方. 落在边上的交点算作相交
+ */
+[[nodiscard]] std::optional<float> intersect_triangle(const ray &r, const point_t &vertex0,
+                                                      const vec3_t &edge1, const vec3_t &edge2,
+                                                      float tmin, float tmax,
+                                                      std::array<float, 3> &bary);
+
+/**
+ * @brief 三个顶点的包围盒, 各维度向外留出aabb::dim_padding
+ */
+[[nodiscard]] aabb triangle_bounds(const std::array<point_t, 3> &vertices);
+
+/**
+ * @brief 用axis轴上的两个平面low, high裁剪三角形, 返回裁剪后多边形的包围盒
+ */
+[[nodiscard]] aabb clipped_triangle_bounds(const std::array<point_t, 3> &vertices, int axis,
+                                           float low, float high);
+
 class triangle : public hittable {
     std::array<point_t, 3> vertices_;
-    unit_vec3 normal_;      // 顶点按右手方向旋转得到的法向
-    float dist_to_origin_;  // A*x+B*y+C*z+D=0中的D
-    float area2_;           // 面积的两倍
-    std::shared_ptr<material> pmat_;
+    unit_vec3 normal_;  // 顶点按右手方向旋转得到的法向
+    const material *pmat_;  // 由场景的材质表持有
     std::array<tex_coords_t, 3> tex_coords_;
-    std::array<vec3_t, 3> edges_;
+    vec3_t edge1_;  // v1 - v0, 与edge2_一起预先计算, 供Möller–Trumbore求交使用
+    vec3_t edge2_;  // v2 - v0
 
 public:
     triangle(const point_t &point0, const point_t &point1, const point_t &point2,
              const tex_coords_t &tex_coords0, const tex_coords_t &tex_coords1, const tex_coords_t &tex_coords2,
-             std::shared_ptr<material> pmat)
-        : vertices_{point0, point1, point2}, pmat_(std::move(pmat)), tex_coords_{tex_coords0, tex_coords1, tex_coords2} {
-        normal_ = (point1 - point0).cross(point2 - point1).normalized();
+             const material *pmat)
+        : vertices_{point0, point1, point2}, pmat_(pmat), tex_coords_{tex_coords0, tex_coords1, tex_coords2} {
+        edge1_ = point1 - point0;
+        edge2_ = point2 - point0;
+        normal_ = edge1_.cross(edge2_).normalized();
         if (normal_.len_sq() == 0) {
             std::cerr << "bad triangle: collinear edges\n";
         }
-        dist_to_origin_ = -normal_.dot(point0);
-        edges_ = {point2 - point1, point0 - point2, point1 - point0};
-        area2_ = edges_[0].cross(edges_[1]).len();
     }
 
-private:
-    [[nodiscard]] point_t vertex(int idx) const { return vertices_.at(idx % 3); }
+    /**
+     * @brief 求交只输出交点参数与重心坐标(u, v), 法向与纹理坐标的插值留到surface_interaction()
+     */
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const override;
 
-public:
-    [[nodiscard]] hit_res_t hit(const ray &r, float tmin, float tmax) const override;
+    /**
+     * @brief 由交点参数与重心坐标构造hit_record; 批量求交的三角形块找到最近的交点后也调用它
+     */
+    [[nodiscard]] hit_record surface_interaction(const ray &r,
+                                                 const intersection &isect) const override;
+
+    // 求交使用的预计算数据: 第一个顶点与由它出发的两条边
+    [[nodiscard]] const point_t &vertex0() const { return vertices_[0]; }
 
-    [[nodiscard]] aabb bounding_box() const override;
+    [[nodiscard]] const vec3_t &edge1() const { return edge1_; }
+
+    [[nodiscard]] const vec3_t &edge2() const { return edge2_; }
+
+    [[nodiscard]] aabb bounding_box() const override { return triangle_bounds(vertices_); }
+
+    [[nodiscard]] aabb clipped_bounding_box(int axis, float low, float high) const override {
+        return clipped_triangle_bounds(vertices_, axis, low, high);
+    }
 };
 
 #endif  // RT_TRIANGLE_HPP
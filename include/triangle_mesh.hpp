@@ -0,0 +1,103 @@
+#ifndef RT_TRIANGLE_MESH_HPP
+#define RT_TRIANGLE_MESH_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "aabb.hpp"
+#include "hittable.hpp"
+
+class affine;
+
+/**
+ * @brief 带索引的三角形网格: 顶点位置与纹理坐标各存一份, 由多个面共享, 每个面只保存三个
+ * 32位顶点下标与一个材质下标. 面不是单独的对象: bvh的叶节点直接引用面的下标范围,
+ * 求交时从顶点与索引缓冲区中读取; 交点以intersection::face记录被击中的面
+ */
+class triangle_mesh : public hittable {
+public:
+    using face_t = std::array<std::uint32_t, 3>;
+
+private:
+    std::vector<point_t> positions_;
+    std::vector<tex_coords_t> tex_coords_;  // 与positions_一一对应
+    std::vector<face_t> faces_;
+    std::vector<std::uint32_t> mat_ids_;  // 各面的材质在materials_中的下标
+    std::vector<const material *> materials_;  // 由场景的材质表持有
+
+public:
+    triangle_mesh() = default;
+
+    triangle_mesh(std::vector<point_t> positions, std::vector<tex_coords_t> tex_coords,
+                  std::vector<face_t> faces, std::vector<std::uint32_t> mat_ids,
+                  std::vector<const material *> materials);
+
+    /**
+     * @brief 把另一个网格的顶点、面与材质追加到本网格之后, 顶点与材质的下标随之偏移
+     */
+    void append(const triangle_mesh &other);
+
+    /**
+     * @brief 按order重排各面: 新的第i个面是原来的第order[i]个, 顶点不变.
+     * order中可以有重复的下标, 这些面随之被复制
+     */
+    void reorder_faces(const std::vector<std::uint32_t> &order);
+
+    /**
+     * @brief 与全部面逐个求交, 没有加速结构; 场景中的面由bvh的叶节点按下标范围求交
+     */
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const override;
+
+    /**
+     * @brief 由交点参数与重心坐标构造hit_record, 法向与纹理坐标都在这里才从网格中读取计算
+     */
+    [[nodiscard]] hit_record surface_interaction(const ray &r,
+                                                 const intersection &isect) const override;
+
+    [[nodiscard]] aabb bounding_box() const override;
+
+    [[nodiscard]] aabb face_bounds(std::uint32_t face) const;
+
+    [[nodiscard]] aabb clipped_face_bounds(std::uint32_t face, int axis, float low,
+                                           float high) const;
+
+    [[nodiscard]] std::array<point_t, 3> vertices(std::uint32_t face) const {
+        const auto &indices = faces_[face];
+        return {positions_[indices[0]], positions_[indices[1]], positions_[indices[2]]};
+    }
+
+    [[nodiscard]] const face_t &face(std::uint32_t face) const { return faces_[face]; }
+
+    [[nodiscard]] const std::vector<point_t> &positions() const { return positions_; }
+
+    /**
+     * @brief 用变换后的顶点原地替换网格中从first_vertex开始的一段顶点, 拓扑与纹理坐标都不变,
+     * 引用这些面的bvh可以直接refit. 调用时不能有其他线程正在与网格求交
+     *
+     * @param positions 变换前的顶点, 与这段顶点一一对应
+     * @param to_world 作用于positions的变换
+     */
+    void transform(std::uint32_t first_vertex, const std::vector<point_t> &positions,
+                   const affine &to_world);
+
+    [[nodiscard]] const tex_coords_t &tex_coords(std::uint32_t vertex) const {
+        return tex_coords_[vertex];
+    }
+
+    [[nodiscard]] const material *material_of(std::uint32_t face) const {
+        return materials_[mat_ids_[face]];
+    }
+
+    [[nodiscard]] std::size_t n_faces() const { return faces_.size(); }
+
+    /**
+     * @brief 顶点、纹理坐标、索引与材质下标占用的内存字节数
+     */
+    [[nodiscard]] std::size_t memory_size() const {
+        return positions_.size() * sizeof(point_t) + tex_coords_.size() * sizeof(tex_coords_t) +
+               faces_.size() * sizeof(face_t) + mat_ids_.size() * sizeof(std::uint32_t);
+    }
+};
+
+#endif  // RT_TRIANGLE_MESH_HPP
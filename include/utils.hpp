@@ -1,6 +1,7 @@
 #ifndef RT_UTILS_HPP
 #define RT_UTILS_HPP
 
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
 #include <optional>
@@ -75,6 +76,17 @@ inline void exist_or_abort(const std::filesystem::path &path, const std::string
     }
 }
 
+/**
+ * @brief 64位FNV-1a哈希; 传入上一段数据的结果作为hash, 可以连续计算多段数据的哈希值
+ */
+std::uint64_t fnv1a(const void *data, std::size_t size,
+                    std::uint64_t hash = 14695981039346656037ULL);
+
+/**
+ * @brief 运行时检测CPU(以及操作系统)是否支持AVX2指令集
+ */
+bool cpu_supports_avx2();
+
 float srgb_to_linear(float srgb);
 
 float linear_to_srgb(float linear);
@@ -0,0 +1,75 @@
+#ifndef RT_WIDE_BVH_HPP
+#define RT_WIDE_BVH_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "bvh.hpp"
+#include "hittable.hpp"
+#include "leaf_blocks.hpp"
+
+/**
+ * @brief 多叉BVH节点, 各子节点的包围盒按SoA方式存放, 可以用一次SIMD运算同时与一条光线求交
+ *
+ * @tparam Width 分支数, 4对应SSE, 8对应AVX2
+ */
+template <int Width>
+struct alignas(4 * Width) wide_bvh_node {
+    std::array<std::array<float, Width>, 3> low;   // low[axis][child]
+    std::array<std::array<float, Width>, 3> high;  // high[axis][child]
+    std::array<std::uint32_t, Width> children;  // 子节点下标; 叶子时与bvh_node::offset相同
+    std::array<std::uint16_t, Width> counts;    // 叶子包含的图元数, 内部节点或空位为0
+    std::array<prim_kind, Width> kinds;         // 叶子的图元类型
+};
+
+static_assert(sizeof(wide_bvh_node<4>) == 128, "4-wide node should span two cache lines");
+static_assert(sizeof(wide_bvh_node<8>) == 256, "8-wide node should span four cache lines");
+
+/**
+ * @brief 由二叉bvh折叠得到的多叉BVH, 每个节点保留二叉树中至多Width个子孙节点
+ *
+ * @tparam Width 分支数, 只支持4和8; 8叉树的求交使用AVX2指令, 使用前应检查cpu_supports_avx2()
+ */
+template <int Width>
+class wide_bvh {
+    static_assert(Width == 4 || Width == 8, "only 4-wide and 8-wide BVHs are supported");
+
+    std::vector<wide_bvh_node<Width>> nodes_;
+    leaf_blocks<Width> leaves_;  // 与二叉bvh引用同一组图元, 块宽与分支数相同
+
+    /**
+     * @brief 将二叉树中以index为根的子树折叠为多叉子树, 节点按深度优先顺序追加到nodes_末尾
+     * @return 子树根节点的下标
+     */
+    std::uint32_t collapse(const std::vector<bvh_node> &binary, std::uint32_t index);
+
+public:
+    explicit wide_bvh(const bvh &binary);
+
+    /**
+     * @brief 只求出最近的交点, 不计算着色需要的交点信息
+     */
+    [[nodiscard]] isect_res_t intersect(const ray &r, float tmin, float tmax) const;
+
+    [[nodiscard]] hit_res_t hit(const ray &r, float tmin, float tmax) const {
+        return to_record(r, intersect(r, tmin, tmax));
+    }
+
+    [[nodiscard]] bool occluded(const ray &r, float tmin, float tmax) const;
+};
+
+// 8叉树的遍历按AVX2单独编译
+template <>
+isect_res_t wide_bvh<8>::intersect(const ray &r, float tmin, float tmax) const;
+
+template <>
+bool wide_bvh<8>::occluded(const ray &r, float tmin, float tmax) const;
+
+using bvh4 = wide_bvh<4>;
+using bvh8 = wide_bvh<8>;
+
+extern template class wide_bvh<4>;
+extern template class wide_bvh<8>;
+
+#endif  // RT_WIDE_BVH_HPP
@@ -0,0 +1,93 @@
+#ifndef RT_WORLD_HPP
+#define RT_WORLD_HPP
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "aabb.hpp"
+#include "hittable.hpp"
+#include "rectangle.hpp"
+#include "sphere.hpp"
+#include "triangle_mesh.hpp"
+
+/**
+ * @brief 图元的存放类型, 也是bvh叶节点的类型: 叶节点引用world_t中某一类图元的一段连续范围
+ */
+enum class prim_kind : std::uint8_t {
+    triangle,   // world_t::mesh中的面
+    sphere,     // world_t::spheres
+    rectangle,  // world_t::rectangles
+    object,     // world_t::objects中的图元
+    mixed,      // 只用于叶节点: 包含多种图元, 各自的范围另外记录
+};
+
+constexpr int n_prim_kinds = 4;  // world_t中存放的图元类型数, 不含mixed
+
+/**
+ * @brief 场景的全部图元, 按类型分别连续存放, 这些数组本身就是场景的存储.
+ * 三角形都是网格中的面, 只保存顶点下标; 球面与矩形按值存放; 只有不能按类型打包的图元
+ * (如实例)才以hittable存放. 图元的统一下标按prim_kind的顺序依次排列各类图元
+ */
+struct world_t {
+    triangle_mesh mesh;  // 全部三角形, 包括场景文件中单独定义的三角形
+    std::vector<sphere> spheres;
+    std::vector<rectangle> rectangles;
+    std::vector<std::shared_ptr<hittable>> objects;
+
+    [[nodiscard]] std::size_t size(prim_kind kind) const {
+        switch (kind) {
+            case prim_kind::triangle:
+                return mesh.n_faces();
+            case prim_kind::sphere:
+                return spheres.size();
+            case prim_kind::rectangle:
+                return rectangles.size();
+            default:
+                return objects.size();
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return mesh.n_faces() + spheres.size() + rectangles.size() + objects.size();
+    }
+
+    [[nodiscard]] bool empty() const { return size() == 0; }
+
+    /**
+     * @brief 由统一下标得到图元的类型与在该类型中的下标
+     */
+    [[nodiscard]] std::pair<prim_kind, std::uint32_t> locate(std::size_t index) const {
+        for (int k = 0; k + 1 < n_prim_kinds; k++) {
+            const auto n_prims = size((prim_kind)k);
+            if (index < n_prims) {
+                return {(prim_kind)k, (std::uint32_t)index};
+            }
+            index -= n_prims;
+        }
+        return {prim_kind::object, (std::uint32_t)index};
+    }
+
+    [[nodiscard]] aabb bounding_box(prim_kind kind, std::uint32_t index) const;
+
+    [[nodiscard]] aabb clipped_bounding_box(prim_kind kind, std::uint32_t index, int axis,
+                                            float low, float high) const;
+
+    /**
+     * @brief 按order重排一类图元: 新的第i个图元是原来的第order[i]个.
+     * order中可以有重复的下标(SBVH中被多个叶节点引用的图元), 这些图元随之被复制
+     */
+    void reorder(prim_kind kind, const std::vector<std::uint32_t> &order);
+};
+
+/**
+ * @brief 逐个图元求交, 不使用任何加速结构
+ */
+[[nodiscard]] isect_res_t intersect(const world_t &world, const ray &r, float tmin, float tmax);
+
+[[nodiscard]] hit_res_t hit(const world_t &world, const ray &r, float tmin, float tmax);
+
+[[nodiscard]] bool occluded(const world_t &world, const ray &r, float tmin, float tmax);
+
+#endif  // RT_WORLD_HPP
@@ -1,66 +1,634 @@
 #include "bvh.hpp"
 
 #include <algorithm>
+#include <array>
 #include <execution>
-#include <iostream>
+#include <iterator>
+#include <numeric>
 
-bvh::bvh(world_t &world, int start, int end) {
-    const auto span = end - start;
-    if (span == 1) {
-        bounding_ = world[start]->bounding_box();
-        object_ = world[start];
-        left_ = nullptr, right_ = nullptr;
+#include "parallel.hpp"
+
+namespace {
+/**
+ * @brief 计算中心点落在哪一个桶内, 桶沿axis轴均匀划分bounds
+ */
+int bin_of(const point_t &centroid, const aabb &bounds, int axis, int bins) {
+    const float low = bounds.low()[axis];
+    const float extent = bounds.high()[axis] - low;
+    const auto bin = (int)((float)bins * (centroid[axis] - low) / extent);
+    return std::clamp(bin, 0, bins - 1);
+}
+
+/**
+ * @brief 计算坐标落在哪一个桶内, 桶沿axis轴均匀划分bounds
+ */
+int bin_of(float coord, const aabb &bounds, int axis, int bins) {
+    const float low = bounds.low()[axis];
+    const float extent = bounds.high()[axis] - low;
+    const auto bin = (int)((float)bins * (coord - low) / extent);
+    return std::clamp(bin, 0, bins - 1);
+}
+
+/**
+ * @brief 第bin个桶沿axis轴的左边界
+ */
+float bin_boundary(const aabb &bounds, int axis, int bins, int bin) {
+    const float low = bounds.low()[axis];
+    const float extent = bounds.high()[axis] - low;
+    return low + extent * (float)bin / (float)bins;
+}
+}  // namespace
+
+bvh::bvh(std::shared_ptr<world_t> world, const config &conf)
+    : config_(conf), world_(std::move(world)) {
+    config_.bins = std::clamp(config_.bins, 2, max_bins);
+    config_.max_leaf_size = std::clamp(config_.max_leaf_size, 1, max_leaf_size);
+    leaves_ = leaves<4>();
+    if (world_->empty()) {
+        return;
+    }
+    const auto n_prims = (int)world_->size();
+    std::vector<prim_info> infos(n_prims);
+    std::vector<int> range(n_prims);
+    std::iota(range.begin(), range.end(), 0);
+    std::for_each(std::execution::par, range.begin(), range.end(), [&](int index) {
+        const auto [kind, local] = world_->locate(index);
+        const auto bounding = world_->bounding_box(kind, local);
+        infos[index] = {bounding, bounding.centroid(), index};
+    });
+
+    // 各个子树的节点块按深度优先顺序首尾相连, 拼接后再把相对下标转换为绝对下标
+    node_chunks chunks;
+    if (config_.builder == builder_type::spatial) {
+        auto merge = [](const aabb &box1, const aabb &box2) { return box1.union_with(box2); };
+        auto box_of = [](const prim_info &info) { return info.bounding; };
+        const auto root_bounds = std::transform_reduce(std::execution::par, infos.begin(),
+                                                       infos.end(), aabb{}, merge, box_of);
+        const auto budget = (std::size_t)(std::max(config_.split_budget, 0.0F) * (float)n_prims);
+        spatial_state state{*world_, split_alpha * root_bounds.area(), budget, {}};
+        state.refs.reserve(n_prims + budget);
+        chunks.resize(1);
+        build_spatial(state, chunks[0], std::move(infos), 0);
+        infos = std::move(state.refs);
+    } else if (config_.builder == builder_type::linear) {
+        chunks = build_linear(infos);
     } else {
-        using phit = std::shared_ptr<hittable>;
-        auto sort_world = [&](int dim) {
-            if (dim < 0 || dim > 2) {
-                std::cerr << "bad dimension: dim = " << dim << ", start & end: " << start << " "
-                          << end << "\n";
+        chunks = build_parallel(infos, 0, n_prims, 0);
+    }
+    std::size_t n_nodes = 0;
+    for (auto &&chunk : chunks) {
+        n_nodes += chunk.size();
+    }
+    nodes_.reserve(n_nodes);
+    for (auto &&chunk : chunks) {
+        nodes_.insert(nodes_.end(), chunk.begin(), chunk.end());
+    }
+    for (std::size_t i = 0; i < n_nodes; i++) {
+        if (!nodes_[i].is_leaf()) {
+            nodes_[i].offset += (std::uint32_t)i;
+        }
+    }
+    optimize_treelets();
+
+    assign_leaves(infos);
+    build_cost_ = sah_cost();
+}
+
+void bvh::assign_leaves(const std::vector<prim_info> &refs) {
+    // 同一叶节点中的同类图元取得连续的新位置, 叶节点因此只需记录一段范围;
+    // 包含多种图元的叶节点把各段范围记录在mixed表中
+    for (auto &&indices : prim_indices_) {
+        indices.clear();
+    }
+    std::vector<leaf_ranges> mixed;
+    for (auto &&node : nodes_) {
+        if (!node.is_leaf()) {
+            continue;
+        }
+        leaf_ranges ranges;
+        for (int k = 0; k < n_prim_kinds; k++) {
+            ranges.first[k] = (std::uint32_t)prim_indices_[k].size();
+        }
+        for (std::uint32_t i = node.offset; i < node.offset + node.count; i++) {
+            const auto [kind, index] = world_->locate(refs[i].index);
+            prim_indices_[(int)kind].push_back(index);
+            ranges.count[(int)kind]++;
+        }
+        const auto n_kinds =
+            std::count_if(ranges.count.begin(), ranges.count.end(), [](auto c) { return c > 0; });
+        if (n_kinds == 1) {
+            const auto kind = std::find_if(ranges.count.begin(), ranges.count.end(),
+                                           [](auto c) { return c > 0; }) -
+                              ranges.count.begin();
+            node.kind = (prim_kind)kind;
+            node.offset = ranges.first[kind];
+        } else {
+            node.kind = prim_kind::mixed;
+            node.offset = (std::uint32_t)mixed.size();
+            mixed.push_back(ranges);
+        }
+    }
+    mixed_ = std::make_shared<const std::vector<leaf_ranges>>(std::move(mixed));
+    apply_order();
+}
+
+void bvh::apply_order() {
+    for (int k = 0; k < n_prim_kinds; k++) {
+        world_->reorder((prim_kind)k, prim_indices_[k]);
+    }
+    leaves_ = leaves<4>();
+}
+
+auto bvh::find_split(const std::vector<prim_info> &infos, int start, int end,
+                     const aabb &bounds) const -> split {
+    struct bin {
+        aabb bounding;
+        int count{0};
+    };
+    using bin_grid = std::array<std::array<bin, max_bins>, 3>;
+    const int n_bins = config_.bins;
+    const int span = end - start;
+    auto accumulate = [&](bin_grid &grid, int first, int last) {
+        for (int axis = 0; axis < 3; axis++) {
+            if (bounds.high()[axis] <= bounds.low()[axis]) {
+                continue;
             }
-            std::sort(std::execution::par, world.begin() + start, world.begin() + end,
-                      [&](const phit &h1, const phit &h2) {
-                          return h1->bounding_box().centroid()[dim] <
-                                 h2->bounding_box().centroid()[dim];
-                      });
-        };
-        const int n_split = std::min(span - 1, 12);  // 尝试几次划分
-        int min_idx = start + span / 2;
-        auto min_cost = std::numeric_limits<double>::max();
-        for (int dim = 0; dim < 3; dim++) {
-            sort_world(dim);
-            for (int i = 1; i <= n_split; i++) {
-                const int mid = start + span * i / (n_split + 1);
-                const auto bound_l = ::bounding_box(world, start, mid);
-                const auto bound_r = ::bounding_box(world, mid, end);
-                const double area_l = bound_l.area();
-                const double area_r = bound_r.area();
-                const auto cost = (mid - start) * area_l + (end - mid) * area_r;
-                if (cost < min_cost) {
-                    min_cost = cost;
-                    min_idx = mid;
-                    split_axis_ = dim;
+            for (int i = first; i < last; i++) {
+                auto &target = grid[axis][bin_of(infos[i].centroid, bounds, axis, n_bins)];
+                target.bounding = target.bounding.union_with(infos[i].bounding);
+                target.count++;
+            }
+        }
+    };
+
+    auto grid = std::make_unique<bin_grid>();
+    if (span < parallel_threshold) {
+        accumulate(*grid, start, end);
+    } else {
+        // 大范围的分桶统计按块并行, 最后合并各块的结果
+        const int n_blocks = (span + parallel_threshold - 1) / parallel_threshold;
+        std::vector<bin_grid> partial(n_blocks);
+        std::vector<int> blocks(n_blocks);
+        std::iota(blocks.begin(), blocks.end(), 0);
+        std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](int block) {
+            const int first = start + block * parallel_threshold;
+            accumulate(partial[block], first, std::min(first + parallel_threshold, end));
+        });
+        for (auto &&part : partial) {
+            for (int axis = 0; axis < 3; axis++) {
+                for (int b = 0; b < n_bins; b++) {
+                    auto &target = (*grid)[axis][b];
+                    target.bounding = target.bounding.union_with(part[axis][b].bounding);
+                    target.count += part[axis][b].count;
                 }
             }
         }
-        sort_world(split_axis_);
-        left_ = std::make_unique<bvh>(world, start, min_idx);
-        right_ = std::make_unique<bvh>(world, min_idx, end);
-        bounding_ = left_->bounding_.union_with(right_->bounding_);
-        object_ = nullptr;
     }
+
+    split best;
+    best.cost = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++) {
+        const auto &bins = (*grid)[axis];
+        // 从右向左扫描, cost_right[b]为(b, n_bins)范围内的桶划分到右侧时的代价
+        std::array<float, max_bins> cost_right{};
+        std::array<aabb, max_bins> bounds_right;
+        aabb acc;
+        int count = 0;
+        for (int b = n_bins - 1; b > 0; b--) {
+            acc = acc.union_with(bins[b].bounding);
+            count += bins[b].count;
+            cost_right[b - 1] = count > 0 ? (float)count * acc.area() : 0;
+            bounds_right[b - 1] = acc;
+        }
+        acc = aabb{};
+        count = 0;
+        for (int b = 0; b < n_bins - 1; b++) {
+            acc = acc.union_with(bins[b].bounding);
+            count += bins[b].count;
+            if (count == 0 || count == span) {
+                continue;
+            }
+            const float cost = (float)count * acc.area() + cost_right[b];
+            if (cost < best.cost) {
+                best = {axis, b, cost, acc, bounds_right[b], count, span - count};
+            }
+        }
+    }
+    return best;
+}
+
+auto bvh::find_spatial_split(const spatial_state &state, const std::vector<prim_info> &refs,
+                             const aabb &bounds) const -> split {
+    struct bin {
+        aabb bounding;
+        int enter{0};  // 从此桶开始的引用数
+        int exit{0};   // 在此桶结束的引用数
+    };
+    const int n_bins = config_.bins;
+    const auto span = (int)refs.size();
+    split best;
+    best.cost = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 3; axis++) {
+        if (bounds.high()[axis] <= bounds.low()[axis]) {
+            continue;
+        }
+        std::array<bin, max_bins> bins;
+        for (auto &&ref : refs) {
+            const int first = bin_of(ref.bounding.low()[axis], bounds, axis, n_bins);
+            const int last = bin_of(ref.bounding.high()[axis], bounds, axis, n_bins);
+            if (first == last) {
+                bins[first].bounding = bins[first].bounding.union_with(ref.bounding);
+            } else {
+                // 跨越多个桶的引用按桶的边界切开, 每一段只计入所在的桶
+                const auto [kind, index] = state.world.locate(ref.index);
+                for (int b = first; b <= last; b++) {
+                    const auto clipped = state.world
+                                             .clipped_bounding_box(
+                                                 kind, index, axis,
+                                                 bin_boundary(bounds, axis, n_bins, b),
+                                                 bin_boundary(bounds, axis, n_bins, b + 1))
+                                             .intersect_with(ref.bounding);
+                    if (!clipped.empty()) {
+                        bins[b].bounding = bins[b].bounding.union_with(clipped);
+                    }
+                }
+            }
+            bins[first].enter++;
+            bins[last].exit++;
+        }
+
+        // 在第b个桶右边界处划分时, 左侧为在[0, b]内开始的引用, 右侧为在(b, n_bins)内结束的引用
+        std::array<aabb, max_bins> bounds_right;
+        std::array<int, max_bins> count_right{};
+        aabb acc;
+        int count = 0;
+        for (int b = n_bins - 1; b > 0; b--) {
+            acc = acc.union_with(bins[b].bounding);
+            count += bins[b].exit;
+            bounds_right[b - 1] = acc;
+            count_right[b - 1] = count;
+        }
+        acc = aabb{};
+        count = 0;
+        for (int b = 0; b < n_bins - 1; b++) {
+            acc = acc.union_with(bins[b].bounding);
+            count += bins[b].enter;
+            const int n_right = count_right[b];
+            if (count == 0 || n_right == 0 || acc.empty() || bounds_right[b].empty()) {
+                continue;
+            }
+            if ((std::size_t)(count + n_right - span) > state.budget) {
+                continue;
+            }
+            const float cost = (float)count * acc.area() + (float)n_right * bounds_right[b].area();
+            if (cost < best.cost) {
+                best = {axis, b, cost, acc, bounds_right[b], count, n_right};
+            }
+        }
+    }
+    return best;
+}
+
+bool bvh::prefer_leaf(int span, const aabb &bounds, const split &best) const {
+    const float area = bounds.area();
+    if (best.axis < 0 || area <= 0) {
+        return true;
+    }
+    const float leaf_cost = config_.cost_ratio * (float)span;
+    const float split_cost = 1 + config_.cost_ratio * best.cost / area;
+    return leaf_cost <= split_cost;
+}
+
+std::optional<std::pair<int, int>> bvh::partition(std::vector<prim_info> &infos, int start,
+                                                  int end, int depth, bool allow_leaf) const {
+    const auto span = end - start;
+    if (span == 1) {
+        return std::nullopt;
+    }
+    const bool parallel = span >= parallel_threshold;
+    const auto first = infos.begin() + start;
+    const auto last = infos.begin() + end;
+
+    auto centroid_box = [](const prim_info &info) { return aabb{info.centroid, info.centroid}; };
+    auto merge = [](const aabb &box1, const aabb &box2) { return box1.union_with(box2); };
+    const auto centroid_bounds =
+        parallel ? std::transform_reduce(std::execution::par, first, last, aabb{}, merge,
+                                         centroid_box)
+                 : std::transform_reduce(first, last, aabb{}, merge, centroid_box);
+
+    // 过深时改用中位数划分, 保证遍历栈不会溢出
+    const auto best =
+        depth < max_depth / 2 ? find_split(infos, start, end, centroid_bounds) : split{};
+
+    // 图元数不多时比较SAH代价(以一次节点遍历的代价为单位), 叶节点更划算时不再划分
+    if (allow_leaf && span <= config_.max_leaf_size) {
+        aabb bounds;
+        for (auto it = first; it != last; ++it) {
+            bounds = bounds.union_with(it->bounding);
+        }
+        if (prefer_leaf(span, bounds, best)) {
+            return std::nullopt;
+        }
+    }
+
+    if (best.axis >= 0) {
+        auto left_side = [&](const prim_info &info) {
+            return bin_of(info.centroid, centroid_bounds, best.axis, config_.bins) <= best.bin;
+        };
+        const auto mid = parallel ? std::partition(std::execution::par, first, last, left_side)
+                                  : std::partition(first, last, left_side);
+        return std::make_pair((int)(mid - infos.begin()), best.axis);
+    }
+
+    int axis = 0;
+    const auto diagonal = centroid_bounds.high() - centroid_bounds.low();
+    if (diagonal.y() > diagonal[axis]) {
+        axis = 1;
+    }
+    if (diagonal.z() > diagonal[axis]) {
+        axis = 2;
+    }
+    const auto mid = first + span / 2;
+    std::nth_element(first, mid, last, [&](const prim_info &info1, const prim_info &info2) {
+        return info1.centroid[axis] < info2.centroid[axis];
+    });
+    return std::make_pair((int)(mid - infos.begin()), axis);
+}
+
+void bvh::build_serial(std::vector<bvh_node> &nodes, std::vector<prim_info> &infos, int start,
+                       int end, int depth) const {
+    const auto index = nodes.size();
+    nodes.emplace_back();
+    const auto part = partition(infos, start, end, depth);
+    if (!part.has_value()) {
+        auto &leaf = nodes[index];
+        for (int i = start; i < end; i++) {
+            leaf.bounding = leaf.bounding.union_with(infos[i].bounding);
+        }
+        leaf.offset = start;
+        leaf.count = end - start;
+        return;
+    }
+
+    const auto [mid, axis] = part.value();
+    build_serial(nodes, infos, start, mid, depth + 1);
+    const auto right = nodes.size();
+    build_serial(nodes, infos, mid, end, depth + 1);
+
+    auto &node = nodes[index];
+    node.bounding = nodes[index + 1].bounding.union_with(nodes[right].bounding);
+    node.offset = right - index;
+    node.axis = axis;
+}
+
+auto bvh::build_parallel(std::vector<prim_info> &infos, int start, int end, int depth) const
+    -> node_chunks {
+    const auto span = end - start;
+    if (span < parallel_threshold) {
+        node_chunks chunks(1);
+        chunks[0].reserve(2 * span - 1);
+        build_serial(chunks[0], infos, start, end, depth);
+        return chunks;
+    }
+
+    const auto part = partition(infos, start, end, depth);
+    if (!part.has_value()) {
+        node_chunks chunks(1);
+        build_serial(chunks[0], infos, start, end, depth);
+        return chunks;
+    }
+
+    // 左右子树互不相交, 作为两个任务并行构建
+    const auto [mid, axis] = part.value();
+    const std::array<std::pair<int, int>, 2> ranges = {{{start, mid}, {mid, end}}};
+    std::array<node_chunks, 2> children;
+    auto build_side = [&](int side) {
+        children[side] =
+            build_parallel(infos, ranges[side].first, ranges[side].second, depth + 1);
+    };
+    fork_join([&] { build_side(0); }, [&] { build_side(1); });
+    return join_chunks(children, axis);
+}
+
+auto bvh::join_chunks(std::array<node_chunks, 2> &children, int axis) -> node_chunks {
+    std::size_t n_left = 0;
+    for (auto &&chunk : children[0]) {
+        n_left += chunk.size();
+    }
+    bvh_node root;
+    root.bounding = children[0].front().front().bounding.union_with(
+        children[1].front().front().bounding);
+    root.offset = 1 + n_left;
+    root.axis = axis;
+
+    node_chunks chunks;
+    chunks.reserve(1 + children[0].size() + children[1].size());
+    chunks.push_back({root});
+    for (auto &&child : children) {
+        std::move(child.begin(), child.end(), std::back_inserter(chunks));
+    }
+    return chunks;
+}
+
+void bvh::build_spatial(spatial_state &state, std::vector<bvh_node> &nodes,
+                        std::vector<prim_info> refs, int depth) const {
+    const auto index = nodes.size();
+    nodes.emplace_back();
+    const auto span = (int)refs.size();
+    aabb bounds;
+    aabb centroid_bounds;
+    for (auto &&ref : refs) {
+        bounds = bounds.union_with(ref.bounding);
+        centroid_bounds = centroid_bounds.union_with({ref.centroid, ref.centroid});
+    }
+
+    // 过深时与build_serial一样改用中位数划分, 同时不再切分引用
+    split best;
+    bool spatial = false;
+    if (span > 1 && depth < max_depth / 2) {
+        best = find_split(refs, 0, span, centroid_bounds);
+        // 对象划分两侧重叠明显(或者根本无法按中心划分)时, 空间划分才可能更优
+        const auto overlap = best.axis >= 0 ? best.left.intersect_with(best.right) : bounds;
+        if (state.budget > 0 && !overlap.empty() && overlap.area() > state.min_overlap) {
+            const auto candidate = find_spatial_split(state, refs, bounds);
+            if (candidate.axis >= 0 && (best.axis < 0 || candidate.cost < best.cost)) {
+                best = candidate;
+                spatial = true;
+            }
+        }
+    }
+    if (span == 1 || (span <= config_.max_leaf_size && prefer_leaf(span, bounds, best))) {
+        auto &leaf = nodes[index];
+        leaf.bounding = bounds;
+        leaf.offset = state.refs.size();
+        leaf.count = span;
+        state.refs.insert(state.refs.end(), refs.begin(), refs.end());
+        return;
+    }
+
+    std::vector<prim_info> left;
+    std::vector<prim_info> right;
+    if (spatial) {
+        const float plane = bin_boundary(bounds, best.axis, config_.bins, best.bin + 1);
+        const float cost_left = best.left.area() * (float)best.n_left;
+        const float cost_right = best.right.area() * (float)best.n_right;
+        for (auto &&ref : refs) {
+            if (bin_of(ref.bounding.high()[best.axis], bounds, best.axis, config_.bins) <=
+                best.bin) {
+                left.push_back(ref);
+                continue;
+            }
+            if (bin_of(ref.bounding.low()[best.axis], bounds, best.axis, config_.bins) >
+                best.bin) {
+                right.push_back(ref);
+                continue;
+            }
+            // 比较切分与把整个引用放到某一侧的代价, 后者更优时不再切分(reference unsplitting)
+            const float to_left = best.left.union_with(ref.bounding).area() * (float)best.n_left +
+                                  cost_right - best.right.area();
+            const float to_right = cost_left - best.left.area() +
+                                   best.right.union_with(ref.bounding).area() * (float)best.n_right;
+            const auto [kind, index] = state.world.locate(ref.index);
+            constexpr auto lowest = std::numeric_limits<float>::lowest();
+            constexpr auto highest = std::numeric_limits<float>::max();
+            const auto left_box = state.world
+                                      .clipped_bounding_box(kind, index, best.axis, lowest, plane)
+                                      .intersect_with(ref.bounding);
+            const auto right_box = state.world
+                                       .clipped_bounding_box(kind, index, best.axis, plane, highest)
+                                       .intersect_with(ref.bounding);
+            if (left_box.empty() || right_box.empty()) {
+                // 包围盒跨过了划分平面, 但图元本身只在一侧
+                (left_box.empty() ? right : left).push_back(ref);
+            } else if (state.budget == 0 || std::min(to_left, to_right) < best.cost) {
+                (to_left <= to_right ? left : right).push_back(ref);
+            } else {
+                left.push_back({left_box, left_box.centroid(), ref.index});
+                right.push_back({right_box, right_box.centroid(), ref.index});
+                state.budget--;
+            }
+        }
+    } else if (best.axis >= 0) {
+        for (auto &&ref : refs) {
+            const auto bin = bin_of(ref.centroid, centroid_bounds, best.axis, config_.bins);
+            (bin <= best.bin ? left : right).push_back(ref);
+        }
+    }
+    if (left.empty() || right.empty()) {
+        left.clear();
+        right.clear();
+        best.axis = 0;
+        const auto diagonal = centroid_bounds.high() - centroid_bounds.low();
+        if (diagonal.y() > diagonal[best.axis]) {
+            best.axis = 1;
+        }
+        if (diagonal.z() > diagonal[best.axis]) {
+            best.axis = 2;
+        }
+        const auto mid = refs.begin() + span / 2;
+        std::nth_element(refs.begin(), mid, refs.end(),
+                         [&](const prim_info &info1, const prim_info &info2) {
+                             return info1.centroid[best.axis] < info2.centroid[best.axis];
+                         });
+        left.assign(refs.begin(), mid);
+        right.assign(mid, refs.end());
+    }
+    refs = {};  // 子树构建期间不再需要, 及早释放
+
+    build_spatial(state, nodes, std::move(left), depth + 1);
+    const auto right_index = nodes.size();
+    build_spatial(state, nodes, std::move(right), depth + 1);
+
+    auto &node = nodes[index];
+    node.bounding = nodes[index + 1].bounding.union_with(nodes[right_index].bounding);
+    node.offset = right_index - index;
+    node.axis = best.axis;
 }
 
-hit_res_t bvh::hit(const ray &r, float tmin, float tmax) const {
-    if (!bounding_.hit(r, tmin, tmax)) {
+isect_res_t bvh::intersect(const ray &r, float tmin, float tmax) const {
+    if (nodes_.empty()) {
         return std::nullopt;
     }
-    if (object_ != nullptr) {
-        return object_->hit(r, tmin, tmax);
+    const auto root_entry = nodes_[0].bounding.entry(r, tmin, tmax);
+    if (!root_entry.has_value()) {
+        return std::nullopt;
     }
-    auto rec_l = left_->hit(r, tmin, tmax);
-    if (rec_l.has_value()) {
-        auto rec_r = right_->hit(r, tmin, rec_l->ray_param);
-        return rec_r.has_value() ? rec_r : rec_l;
+    const auto &dir_neg = r.dir_neg();
+
+    // 栈中的节点都已经与光线相交过, 同时记录进入其包围盒时的参数
+    struct entry {
+        std::uint32_t index;
+        float tnear;
+    };
+    std::array<entry, max_depth + 1> stack{};
+    int top = 0;
+    stack[top++] = {0, root_entry.value()};
+
+    const auto &leaves = leaves_;
+    isect_res_t res = std::nullopt;
+    while (top > 0) {
+        const auto current = stack[--top];
+        if (current.tnear >= tmax) {
+            continue;  // 已经找到了更近的交点
+        }
+        const auto &node = nodes_[current.index];
+        if (node.is_leaf()) {
+            const auto isect = leaves.intersect(node.kind, node.offset, node.count, r, tmin, tmax);
+            if (isect.has_value()) {
+                tmax = isect->ray_param;
+                res = isect;
+            }
+            continue;
+        }
+        // 光线沿划分轴正向传播时先经过左子节点, 反向时先经过右子节点; 近端后入栈先访问
+        auto near = current.index + 1;
+        auto far = node.offset;
+        if (dir_neg[node.axis]) {
+            std::swap(near, far);
+        }
+        const auto far_entry = nodes_[far].bounding.entry(r, tmin, tmax);
+        if (far_entry.has_value()) {
+            stack[top++] = {far, far_entry.value()};
+        }
+        const auto near_entry = nodes_[near].bounding.entry(r, tmin, tmax);
+        if (near_entry.has_value()) {
+            stack[top++] = {near, near_entry.value()};
+        }
+    }
+    return res;
+}
+
+bool bvh::occluded(const ray &r, float tmin, float tmax) const {
+    if (nodes_.empty() || !nodes_[0].bounding.hit(r, tmin, tmax)) {
+        return false;
+    }
+    const auto &dir_neg = r.dir_neg();
+
+    // 任意交点都可以结束查询, tmax不会缩小, 入栈的节点也就不需要记录入射参数
+    std::array<std::uint32_t, max_depth + 1> stack{};
+    int top = 0;
+    stack[top++] = 0;
+    const auto &leaves = leaves_;
+    while (top > 0) {
+        const auto current = stack[--top];
+        const auto &node = nodes_[current];
+        if (node.is_leaf()) {
+            if (leaves.occluded(node.kind, node.offset, node.count, r, tmin, tmax)) {
+                return true;
+            }
+            continue;
+        }
+        auto near = current + 1;
+        auto far = node.offset;
+        if (dir_neg[node.axis]) {
+            std::swap(near, far);
+        }
+        if (nodes_[far].bounding.hit(r, tmin, tmax)) {
+            stack[top++] = far;
+        }
+        if (nodes_[near].bounding.hit(r, tmin, tmax)) {
+            stack[top++] = near;
+        }
     }
-    return right_->hit(r, tmin, tmax);
+    return false;
 }
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+
+#include "bvh.hpp"
+#include "mapped_file.hpp"
+#include "utils.hpp"
+
+namespace {
+constexpr std::array<char, 8> cache_magic = {'r', 't', '-', 'b', 'v', 'h', '\0', '\0'};
+constexpr std::uint32_t cache_version = 3;  // 节点布局或构建算法改变时递增, 使旧缓存失效
+
+/**
+ * @brief 缓存文件头, 之后依次是n_nodes个bvh_node、n_mixed个leaf_ranges,
+ * 以及按类型依次排列的n_prims[kind]个32位图元下标
+ */
+struct cache_header {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t node_size;
+    std::uint64_t key;
+    std::uint64_t n_nodes;
+    std::uint64_t n_mixed;
+    std::array<std::uint64_t, n_prim_kinds> n_prims;
+};
+
+template <typename T>
+std::uint64_t hash_value(const T &value, std::uint64_t hash) {
+    return fnv1a(&value, sizeof(value), hash);
+}
+
+/**
+ * @brief 从data中取出count个T复制到out, 先用剩余的字节数限制数量再相乘,
+ * 损坏的数量不会使乘法溢出而通过大小检查
+ */
+template <typename T>
+bool take(const char *&data, std::size_t &remaining, std::uint64_t count, std::vector<T> &out) {
+    if (count > remaining / sizeof(T)) {
+        return false;
+    }
+    out.resize(count);
+    std::memcpy(out.data(), data, count * sizeof(T));
+    data += count * sizeof(T);
+    remaining -= count * sizeof(T);
+    return true;
+}
+
+/**
+ * @brief 从根节点出发遍历整棵树, 检查它能被安全地遍历: 每个节点恰好被访问一次,
+ * 右子节点位于左子树之后, 叶节点的深度不超过遍历栈允许的bvh::max_depth,
+ * 叶节点的图元数不超过bvh::max_leaf_size, mixed表中的每一项恰好属于一个叶节点,
+ * 且各类叶节点恰好覆盖[0, n_prims[kind])中的每个位置一次
+ */
+bool valid_tree(const std::vector<bvh_node> &nodes, const std::vector<leaf_ranges> &mixed,
+                const std::array<std::uint64_t, n_prim_kinds> &n_prims) {
+    struct entry {
+        std::uint32_t index;
+        int depth;
+    };
+    std::vector<bool> visited(nodes.size());
+    std::vector<bool> mixed_used(mixed.size());
+    std::array<std::vector<bool>, n_prim_kinds> covered;
+    for (int k = 0; k < n_prim_kinds; k++) {
+        covered[k].resize(n_prims[k]);
+    }
+    auto cover = [&](int kind, std::uint32_t first, std::uint32_t count) {
+        if (first + (std::size_t)count > covered[kind].size()) {
+            return false;
+        }
+        for (std::uint32_t i = first; i < first + count; i++) {
+            if (covered[kind][i]) {
+                return false;
+            }
+            covered[kind][i] = true;
+        }
+        return true;
+    };
+    std::vector<entry> stack{{0, 0}};
+    while (!stack.empty()) {
+        const auto [index, depth] = stack.back();
+        stack.pop_back();
+        if (index >= nodes.size() || visited[index] || depth > bvh::max_depth) {
+            return false;
+        }
+        visited[index] = true;
+        const auto &node = nodes[index];
+        if (node.is_leaf()) {
+            if (node.count > bvh::max_leaf_size) {
+                return false;
+            }
+            if (node.kind != prim_kind::mixed) {
+                if ((int)node.kind >= n_prim_kinds ||
+                    !cover((int)node.kind, node.offset, node.count)) {
+                    return false;
+                }
+                continue;
+            }
+            if (node.offset >= mixed.size() || mixed_used[node.offset]) {
+                return false;
+            }
+            mixed_used[node.offset] = true;
+            const auto &ranges = mixed[node.offset];
+            std::uint32_t total = 0;
+            for (int k = 0; k < n_prim_kinds; k++) {
+                if (!cover(k, ranges.first[k], ranges.count[k])) {
+                    return false;
+                }
+                total += ranges.count[k];
+            }
+            if (total != node.count) {
+                return false;
+            }
+            continue;
+        }
+        if (node.offset <= index + 1) {
+            return false;
+        }
+        stack.push_back({node.offset, depth + 1});
+        stack.push_back({index + 1, depth + 1});
+    }
+    auto all = [](const std::vector<bool> &flags) {
+        return std::all_of(flags.begin(), flags.end(), [](bool f) { return f; });
+    };
+    return all(visited) && all(mixed_used) &&
+           std::all_of(covered.begin(), covered.end(), all);
+}
+}  // namespace
+
+std::uint64_t bvh::cache_key(const config &conf, std::uint64_t geometry) {
+    // 逐个字段计算, 避免结构体中的填充字节影响结果
+    auto hash = hash_value(cache_version, geometry);
+    hash = hash_value(conf.builder, hash);
+    hash = hash_value(conf.bins, hash);
+    hash = hash_value(conf.max_leaf_size, hash);
+    hash = hash_value(conf.cost_ratio, hash);
+    hash = hash_value(conf.split_budget, hash);
+    hash = hash_value(conf.lbvh_sah_top, hash);
+    hash = hash_value(conf.treelet_passes, hash);
+    return hash;
+}
+
+std::optional<bvh> bvh::load(const std::filesystem::path &path, std::uint64_t key,
+                             std::shared_ptr<world_t> world, const config &conf) {
+    const mapped_file file{path};
+    if (!file.is_open() || file.size() < sizeof(cache_header)) {
+        return std::nullopt;
+    }
+    cache_header header{};
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (header.magic != cache_magic || header.version != cache_version ||
+        header.node_size != sizeof(bvh_node) || header.key != key || header.n_nodes == 0) {
+        return std::nullopt;
+    }
+
+    bvh tree;
+    tree.config_ = conf;
+    std::vector<leaf_ranges> mixed;
+    const char *data = file.data() + sizeof(header);
+    std::size_t remaining = file.size() - sizeof(header);
+    if (!take(data, remaining, header.n_nodes, tree.nodes_) ||
+        !take(data, remaining, header.n_mixed, mixed)) {
+        return std::nullopt;
+    }
+    for (int k = 0; k < n_prim_kinds; k++) {
+        if (!take(data, remaining, header.n_prims[k], tree.prim_indices_[k])) {
+            return std::nullopt;
+        }
+    }
+    if (remaining != 0) {
+        return std::nullopt;
+    }
+
+    // 键相同时文件内容应当可信, 仍然完整地检查一遍, 损坏或键冲突的文件不会导致越界访问,
+    // 也不会使遍历栈溢出
+    if (!valid_tree(tree.nodes_, mixed, header.n_prims)) {
+        return std::nullopt;
+    }
+    // world中的每个图元都至少被引用一次; 只有SBVH允许同一图元出现在多个叶节点中,
+    // 其他构建算法的图元下标必须恰好是world中这一类图元的一个排列
+    const bool allow_duplicates = conf.builder == builder_type::spatial;
+    for (int k = 0; k < n_prim_kinds; k++) {
+        const auto n_prims = world->size((prim_kind)k);
+        std::vector<std::uint32_t> refs(n_prims);
+        for (auto &&index : tree.prim_indices_[k]) {
+            if (index >= n_prims) {
+                return std::nullopt;
+            }
+            refs[index]++;
+        }
+        for (auto &&count : refs) {
+            if (count == 0 || (count > 1 && !allow_duplicates)) {
+                return std::nullopt;
+            }
+        }
+    }
+    tree.world_ = std::move(world);
+    tree.mixed_ = std::make_shared<const std::vector<leaf_ranges>>(std::move(mixed));
+    tree.apply_order();
+    tree.build_cost_ = tree.sah_cost();
+    return tree;
+}
+
+bool bvh::save(const std::filesystem::path &path, std::uint64_t key) const {
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    auto temp_path = path;
+    temp_path += ".tmp" + std::to_string(random_int(0, 1 << 30));
+
+    cache_header header{cache_magic, cache_version, sizeof(bvh_node), key,
+                        nodes_.size(), mixed_->size(), {}};
+    for (int k = 0; k < n_prim_kinds; k++) {
+        header.n_prims[k] = prim_indices_[k].size();
+    }
+    {
+        std::ofstream out{temp_path, std::ios::binary};
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(nodes_.data()),
+                  (std::streamsize)(nodes_.size() * sizeof(bvh_node)));
+        out.write(reinterpret_cast<const char *>(mixed_->data()),
+                  (std::streamsize)(mixed_->size() * sizeof(leaf_ranges)));
+        for (auto &&indices : prim_indices_) {
+            out.write(reinterpret_cast<const char *>(indices.data()),
+                      (std::streamsize)(indices.size() * sizeof(std::uint32_t)));
+        }
+        out.close();
+        if (!out) {
+            std::filesystem::remove(temp_path, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::filesystem::remove(temp_path, error);
+        return false;
+    }
+    return true;
+}
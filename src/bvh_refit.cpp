@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <array>
+#include <execution>
+#include <limits>
+#include <numeric>
+
+#include "bvh.hpp"
+#include "parallel.hpp"
+
+float bvh::sah_cost() const {
+    if (nodes_.empty()) {
+        return 0;
+    }
+    const float root_area = nodes_.front().bounding.area();
+    if (root_area <= 0) {
+        return 0;
+    }
+    // 每个内部节点计一次遍历的代价, 叶节点按图元数计求交的代价, 均按被光线击中的概率加权
+    const auto cost = std::transform_reduce(
+        std::execution::par, nodes_.begin(), nodes_.end(), 0.0, std::plus<>(),
+        [&](const bvh_node &node) {
+            const double weight = node.is_leaf() ? config_.cost_ratio * (float)node.count : 1;
+            return weight * node.bounding.area();
+        });
+    return (float)(cost / root_area);
+}
+
+aabb bvh::refit_node(std::uint32_t index) {
+    auto &node = nodes_[index];
+    if (node.is_leaf()) {
+        aabb bounding;
+        for_each_range(node, [&](prim_kind kind, std::uint32_t first, std::uint32_t count) {
+            for (std::uint32_t i = first; i < first + count; i++) {
+                bounding = bounding.union_with(world_->bounding_box(kind, i));
+            }
+        });
+        node.bounding = bounding;
+        return bounding;
+    }
+
+    // 左右子树的节点在数组中互不相交, 可以同时写入
+    const std::array<std::uint32_t, 2> children = {index + 1, node.offset};
+    std::array<aabb, 2> boxes;
+    if (node.offset - index - 1 >= (std::uint32_t)parallel_threshold) {
+        fork_join([&] { boxes[0] = refit_node(children[0]); },
+                  [&] { boxes[1] = refit_node(children[1]); });
+    } else {
+        boxes[0] = refit_node(children[0]);
+        boxes[1] = refit_node(children[1]);
+    }
+    node.bounding = boxes[0].union_with(boxes[1]);
+    return node.bounding;
+}
+
+void bvh::refit() {
+    if (nodes_.empty()) {
+        return;
+    }
+    refit_node(0);
+}
+
+void bvh::restore_order() {
+    // 每个图元至少被一个叶节点引用, 取第一次出现的位置即可还原, SBVH复制的图元随之去掉
+    for (int k = 0; k < n_prim_kinds; k++) {
+        const auto &indices = prim_indices_[k];
+        if (indices.empty()) {
+            continue;
+        }
+        const auto n_prims = *std::max_element(indices.begin(), indices.end()) + 1;
+        constexpr auto unassigned = std::numeric_limits<std::uint32_t>::max();
+        std::vector<std::uint32_t> first_slot(n_prims, unassigned);
+        for (std::uint32_t i = 0; i < indices.size(); i++) {
+            if (first_slot[indices[i]] == unassigned) {
+                first_slot[indices[i]] = i;
+            }
+        }
+        world_->reorder((prim_kind)k, first_slot);
+    }
+    for (auto &&indices : prim_indices_) {
+        indices.clear();
+    }
+}
+
+bool bvh::update() {
+    refit();
+    if (sah_cost() <= config_.rebuild_threshold * build_cost_) {
+        return false;
+    }
+    restore_order();
+    *this = bvh{world_, config_};
+    return true;
+}
@@ -0,0 +1,163 @@
+#include <array>
+#include <execution>
+#include <numeric>
+#include <ostream>
+
+#include "bvh.hpp"
+
+std::size_t bvh::memory_size() const {
+    auto bytes = nodes_.size() * sizeof(bvh_node) + mixed_->size() * sizeof(leaf_ranges);
+    for (auto &&indices : prim_indices_) {
+        bytes += indices.size() * sizeof(std::uint32_t);
+    }
+    return bytes;
+}
+
+auto bvh::stats() const -> statistics {
+    statistics res;
+    res.n_nodes = nodes_.size();
+    res.leaf_sizes.resize(max_leaf_size + 1);
+    res.memory = memory_size();
+    if (nodes_.empty()) {
+        return res;
+    }
+    res.sah_cost = sah_cost();
+
+    // 节点按深度优先顺序存放, 子节点的下标总是大于父节点, 顺序扫描即可得到各节点的深度
+    const auto n_nodes = nodes_.size();
+    std::vector<int> depths(n_nodes);
+    std::size_t depth_sum = 0;
+    double overlap = 0;
+    for (std::size_t i = 0; i < n_nodes; i++) {
+        const auto &node = nodes_[i];
+        res.max_depth = std::max(res.max_depth, depths[i]);
+        if (node.is_leaf()) {
+            res.n_leaves++;
+            res.n_prim_refs += node.count;
+            if (node.count >= res.leaf_sizes.size()) {
+                res.leaf_sizes.resize(node.count + 1);
+            }
+            res.leaf_sizes[node.count]++;
+            if (node.kind == prim_kind::mixed) {
+                res.n_mixed_leaves++;
+            }
+            depth_sum += depths[i];
+            continue;
+        }
+        depths[i + 1] = depths[i] + 1;
+        depths[node.offset] = depths[i] + 1;
+        const auto common = nodes_[i + 1].bounding.intersect_with(nodes_[node.offset].bounding);
+        if (!common.empty()) {
+            overlap += common.area();
+        }
+    }
+    res.avg_leaf_depth = (float)depth_sum / (float)res.n_leaves;
+    const float root_area = nodes_.front().bounding.area();
+    if (root_area > 0) {
+        res.overlap = (float)(overlap / root_area);
+    }
+
+    // 以i为根的子树占据下标[i, subtree_end[i]), 逆序扫描时右子节点总是已经处理过
+    std::vector<std::uint32_t> subtree_end(n_nodes);
+    for (auto i = n_nodes; i-- > 0;) {
+        const auto &node = nodes_[i];
+        subtree_end[i] = node.is_leaf() ? (std::uint32_t)i + 1 : subtree_end[node.offset];
+    }
+    // prim_boxes[kind][i]: world中这一类的第i个图元的包围盒, 与叶节点引用的位置一一对应
+    std::array<std::vector<aabb>, n_prim_kinds> prim_boxes;
+    double total_area = 0;
+    for (int k = 0; k < n_prim_kinds; k++) {
+        const auto kind = (prim_kind)k;
+        auto &boxes = prim_boxes[k];
+        boxes.resize(world_->size(kind));
+        std::vector<std::uint32_t> range(boxes.size());
+        std::iota(range.begin(), range.end(), 0);
+        std::transform(std::execution::par, range.begin(), range.end(), boxes.begin(),
+                       [&](std::uint32_t i) { return world_->bounding_box(kind, i); });
+        total_area += std::transform_reduce(std::execution::par, boxes.begin(), boxes.end(), 0.0,
+                                            std::plus<>(),
+                                            [](const aabb &box) { return (double)box.area(); });
+    }
+    if (total_area <= 0) {
+        return res;
+    }
+
+    // 对每个节点, 在树中查询与其包围盒重叠且不属于其子树的图元
+    auto foreign_area = [&](std::uint32_t index) {
+        const auto &query = nodes_[index].bounding;
+        const auto last = subtree_end[index];
+        std::array<std::uint32_t, max_depth + 1> stack{};
+        int top = 0;
+        stack[top++] = 0;
+        double area = 0;
+        while (top > 0) {
+            const auto current = stack[--top];
+            if (current >= index && current < last) {
+                continue;
+            }
+            const auto &node = nodes_[current];
+            if (query.intersect_with(node.bounding).empty()) {
+                continue;
+            }
+            if (!node.is_leaf()) {
+                stack[top++] = node.offset;
+                stack[top++] = current + 1;
+                continue;
+            }
+            for_each_range(node, [&](prim_kind kind, std::uint32_t first, std::uint32_t count) {
+                for (std::uint32_t i = first; i < first + count; i++) {
+                    const auto common = query.intersect_with(prim_boxes[(int)kind][i]);
+                    if (!common.empty()) {
+                        area += common.area();
+                    }
+                }
+            });
+        }
+        const auto &node = nodes_[index];
+        const double weight = node.is_leaf() ? config_.cost_ratio * (float)node.count : 1;
+        return weight * area;
+    };
+    std::vector<std::uint32_t> indices(n_nodes);
+    std::iota(indices.begin(), indices.end(), 0);
+    const double epo = std::transform_reduce(std::execution::par, indices.begin(), indices.end(),
+                                             0.0, std::plus<>(), foreign_area);
+    res.epo = (float)(epo / total_area);
+    return res;
+}
+
+void bvh::statistics::print(std::ostream &out) const {
+    out << "BVH statistics:\n";
+    out << "\tnodes: " << n_nodes << ", leaves: " << n_leaves
+        << ", primitive references: " << n_prim_refs << "\n";
+    out << "\tmax depth: " << max_depth << ", average leaf depth: " << avg_leaf_depth << "\n";
+    out << "\tleaf sizes:";
+    for (std::size_t k = 1; k < leaf_sizes.size(); k++) {
+        if (leaf_sizes[k] > 0) {
+            out << " " << k << "x" << leaf_sizes[k];
+        }
+    }
+    out << "\n";
+    out << "\tSAH cost: " << sah_cost << ", overlap: " << overlap << ", EPO: " << epo << "\n";
+    out << "\tmixed leaves: " << n_mixed_leaves << ", memory: " << memory / 1024
+        << " KiB\n\n";
+}
+
+void bvh::statistics::write_json(std::ostream &out) const {
+    out << "{\n";
+    out << "  \"nodes\": " << n_nodes << ",\n";
+    out << "  \"leaves\": " << n_leaves << ",\n";
+    out << "  \"primitive_references\": " << n_prim_refs << ",\n";
+    out << "  \"max_depth\": " << max_depth << ",\n";
+    out << "  \"average_leaf_depth\": " << avg_leaf_depth << ",\n";
+    out << "  \"leaf_sizes\": [";
+    for (std::size_t k = 0; k < leaf_sizes.size(); k++) {
+        out << (k > 0 ? ", " : "") << leaf_sizes[k];
+    }
+    out << "],\n";
+    out << "  \"sah_cost\": " << sah_cost << ",\n";
+    out << "  \"overlap\": " << overlap << ",\n";
+    out << "  \"epo\": " << epo << ",\n";
+    out << "  \"mixed_leaves\": " << n_mixed_leaves << ",\n";
+    out << "  \"memory_bytes\": " << memory << "\n";
+    out << "}\n";
+}
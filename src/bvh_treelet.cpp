@@ -0,0 +1,207 @@
+#include <array>
+#include <execution>
+#include <limits>
+
+#include "bvh.hpp"
+
+namespace {
+/**
+ * @brief 非零整数最低的1所在的位
+ */
+int lowest_bit(int bits) {
+    int pos = 0;
+    while ((bits & (1 << pos)) == 0) {
+        pos++;
+    }
+    return pos;
+}
+}  // namespace
+
+/**
+ * @brief 重构过程中使用的树: 内部节点的子节点以下标显式记录, 不再要求深度优先的顺序.
+ * 叶节点的offset与count保持不变, 内部节点的offset不再使用
+ */
+struct bvh::linked_tree {
+    std::vector<bvh_node> nodes;
+    std::vector<std::array<std::uint32_t, 2>> children;
+    std::vector<float> costs;  // 以各节点为根的子树的SAH代价(未除以根节点的表面积)
+};
+
+void bvh::restructure_treelet(linked_tree &tree, std::uint32_t index) const {
+    // 子孙treelet可能已经被重构过, 先按子节点的代价更新本节点的代价
+    const auto [left, right] = tree.children[index];
+    tree.costs[index] = tree.nodes[index].bounding.area() + tree.costs[left] + tree.costs[right];
+
+    // 逐个展开表面积最大的内部叶节点, 被展开的节点成为treelet的内部节点, 重构时可以重新利用
+    std::array<std::uint32_t, treelet_size> leaves{left, right};
+    std::array<std::uint32_t, treelet_size - 1> internals{index};
+    int n_leaves = 2;
+    int n_internals = 1;
+    while (n_leaves < treelet_size) {
+        int widest = -1;
+        float widest_area = -1;
+        for (int i = 0; i < n_leaves; i++) {
+            const auto &node = tree.nodes[leaves[i]];
+            if (!node.is_leaf() && node.bounding.area() > widest_area) {
+                widest = i;
+                widest_area = node.bounding.area();
+            }
+        }
+        if (widest < 0) {
+            break;
+        }
+        const auto opened = leaves[widest];
+        internals[n_internals++] = opened;
+        leaves[widest] = tree.children[opened][0];
+        leaves[n_leaves++] = tree.children[opened][1];
+    }
+    if (n_leaves < 3) {
+        return;
+    }
+
+    // 动态规划: 子集s的最优代价为其包围盒面积(一次遍历)加上最优划分两侧的代价之和.
+    // s的真子集在数值上总是小于s, 按数值顺序计算即可
+    constexpr int max_subsets = 1 << treelet_size;
+    const int n_subsets = 1 << n_leaves;
+    std::array<aabb, max_subsets> boxes;
+    std::array<float, max_subsets> best_cost{};
+    std::array<std::uint8_t, max_subsets> best_part{};
+    for (int s = 1; s < n_subsets; s++) {
+        const int lowest = s & -s;
+        const int rest = s ^ lowest;
+        const int leaf = lowest_bit(lowest);
+        boxes[s] = tree.nodes[leaves[leaf]].bounding.union_with(boxes[rest]);
+        if (rest == 0) {
+            best_cost[s] = tree.costs[leaves[leaf]];
+            continue;
+        }
+        // 只枚举包含最低位的一侧, 避免同一种划分被计算两次
+        float best = std::numeric_limits<float>::max();
+        for (int part = (s - 1) & s; part > 0; part = (part - 1) & s) {
+            if ((part & lowest) == 0) {
+                continue;
+            }
+            const float cost = best_cost[part] + best_cost[s ^ part];
+            if (cost < best) {
+                best = cost;
+                best_part[s] = (std::uint8_t)part;
+            }
+        }
+        best_cost[s] = boxes[s].area() + best;
+    }
+    const int full = n_subsets - 1;
+    constexpr float min_gain = 1e-4F;
+    if (best_cost[full] >= tree.costs[index] * (1 - min_gain)) {
+        return;
+    }
+
+    // 按最优划分重建treelet, 根节点仍使用index, 其余内部节点依次重新利用
+    int next = 1;
+    auto build = [&](auto &&self, int subset, std::uint32_t slot) -> void {
+        const std::array<int, 2> parts = {best_part[subset], subset ^ best_part[subset]};
+        for (int side = 0; side < 2; side++) {
+            const int part = parts[side];
+            if ((part & (part - 1)) == 0) {
+                tree.children[slot][side] = leaves[lowest_bit(part)];
+                continue;
+            }
+            const auto child = internals[next++];
+            tree.children[slot][side] = child;
+            self(self, part, child);
+        }
+        tree.nodes[slot].bounding = boxes[subset];
+        tree.costs[slot] = best_cost[subset];
+    };
+    build(build, full, index);
+}
+
+void bvh::optimize_treelets() {
+    const auto n_nodes = nodes_.size();
+    if (config_.treelet_passes <= 0 || n_nodes < 5) {
+        return;
+    }
+    linked_tree tree{nodes_, std::vector<std::array<std::uint32_t, 2>>(n_nodes),
+                     std::vector<float>(n_nodes)};
+    for (auto i = n_nodes; i-- > 0;) {
+        const auto &node = nodes_[i];
+        const float area = node.bounding.area();
+        if (node.is_leaf()) {
+            tree.costs[i] = config_.cost_ratio * (float)node.count * area;
+            continue;
+        }
+        tree.children[i] = {(std::uint32_t)i + 1, node.offset};
+        tree.costs[i] = area + tree.costs[i + 1] + tree.costs[node.offset];
+    }
+
+    std::vector<int> heights(n_nodes);
+    for (int pass = 0; pass < config_.treelet_passes; pass++) {
+        // 后序遍历求出各内部节点的高度, 按高度分批: 同一批节点的子树互不相交
+        std::vector<std::vector<std::uint32_t>> levels;
+        std::vector<std::pair<std::uint32_t, bool>> stack{{0, false}};
+        while (!stack.empty()) {
+            const auto [index, visited] = stack.back();
+            stack.pop_back();
+            if (tree.nodes[index].is_leaf()) {
+                heights[index] = 0;
+                continue;
+            }
+            const auto [left, right] = tree.children[index];
+            if (!visited) {
+                stack.emplace_back(index, true);
+                stack.emplace_back(right, false);
+                stack.emplace_back(left, false);
+                continue;
+            }
+            heights[index] = std::max(heights[left], heights[right]) + 1;
+            if (heights[index] > (int)levels.size()) {
+                levels.resize(heights[index]);
+            }
+            levels[heights[index] - 1].push_back(index);
+        }
+        for (auto &&level : levels) {
+            std::for_each(std::execution::par, level.begin(), level.end(),
+                          [&](std::uint32_t index) { restructure_treelet(tree, index); });
+        }
+    }
+
+    // 重新按深度优先顺序排列; 划分轴取两个子节点中心相距最远的轴, 较低的一侧作为左子节点
+    std::vector<bvh_node> result;
+    result.reserve(n_nodes);
+    struct entry {
+        std::uint32_t index;
+        std::uint32_t parent;  // 右子节点需要回填父节点的offset, 左子节点为UINT32_MAX
+        int depth;
+    };
+    std::vector<entry> stack{{0, UINT32_MAX, 0}};
+    while (!stack.empty()) {
+        const auto current = stack.back();
+        stack.pop_back();
+        if (current.depth >= max_depth) {
+            return;  // 重构后的树过深, 遍历栈可能溢出, 保留原来的树
+        }
+        const auto position = (std::uint32_t)result.size();
+        if (current.parent != UINT32_MAX) {
+            result[current.parent].offset = position;
+        }
+        result.push_back(tree.nodes[current.index]);
+        if (result.back().is_leaf()) {
+            continue;
+        }
+        auto [left, right] = tree.children[current.index];
+        const auto diff = tree.nodes[right].bounding.centroid() -
+                          tree.nodes[left].bounding.centroid();
+        int axis = 0;
+        for (int i = 1; i < 3; i++) {
+            if (std::abs(diff[i]) > std::abs(diff[axis])) {
+                axis = i;
+            }
+        }
+        if (diff[axis] < 0) {
+            std::swap(left, right);
+        }
+        result.back().axis = (std::uint8_t)axis;
+        stack.push_back({right, position, current.depth + 1});
+        stack.push_back({left, UINT32_MAX, current.depth + 1});
+    }
+    nodes_ = std::move(result);
+}
@@ -2,24 +2,26 @@
 
 #include "aabb.hpp"
 
-hit_res_t hit(const world_t &world, const ray &r, float tmin, float tmax) {
-    hit_res_t res = std::nullopt;
-    float closest = tmax;
-    for (auto &&object : world) {
-        const auto record = object->hit(r, tmin, closest);
-        if (record.has_value()) {
-            closest = record->ray_param;
-            res = record;
-        }
-    }
-    return res;
+aabb hittable::clipped_bounding_box(int axis, float low, float high) const {
+    const auto bounding = bounding_box();
+    auto slab_low = bounding.low();
+    auto slab_high = bounding.high();
+    slab_low[axis] = low;
+    slab_high[axis] = high;
+    return bounding.intersect_with({slab_low, slab_high});
+}
+
+hit_res_t hittable::hit(const ray &r, float tmin, float tmax) const {
+    return to_record(r, intersect(r, tmin, tmax));
+}
+
+bool hittable::occluded(const ray &r, float tmin, float tmax) const {
+    return intersect(r, tmin, tmax).has_value();
 }
 
-aabb bounding_box(const world_t &world, int start, int end) {
-    assert(end - start > 0);
-    aabb bound = world[start]->bounding_box();
-    for (int i = start + 1; i < end; i++) {
-        bound = bound.union_with(world[i]->bounding_box());
+hit_res_t to_record(const ray &r, const isect_res_t &isect) {
+    if (!isect.has_value()) {
+        return std::nullopt;
     }
-    return bound;
+    return isect->prim->surface_interaction(r, isect.value());
 }
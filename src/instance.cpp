@@ -0,0 +1,35 @@
+#include "instance.hpp"
+
+#include "ray.hpp"
+
+std::pair<ray, float> instance::to_local(const ray &r) const {
+    // 物体空间中的光线方向需要重新归一化, 光线参数随之按长度之比缩放
+    const auto direction = to_object_.apply_vector(r.direction());
+    const float scale = direction.len();
+    return {ray{to_object_.apply_point(r.origin()), direction}, scale};
+}
+
+isect_res_t instance::intersect(const ray &r, float tmin, float tmax) const {
+    const auto [local, scale] = to_local(r);
+    const auto isect = blas_->intersect(local, tmin * scale, tmax * scale);
+    if (!isect.has_value()) {
+        return std::nullopt;
+    }
+    return intersection{isect->ray_param / scale, isect->uv, isect->face, this, isect->prim};
+}
+
+hit_record instance::surface_interaction(const ray &r, const intersection &isect) const {
+    const auto [local, scale] = to_local(r);
+    const intersection inner{isect.ray_param * scale, isect.uv, isect.face, isect.child};
+    auto record = isect.child->surface_interaction(local, inner);
+    record.ray_param = isect.ray_param;
+    record.point = r.point_at(record.ray_param);
+    // 法向按逆变换的转置变换, 不改变它与光线方向夹角的正负
+    record.normal = to_object_.apply_transposed(record.normal).normalized();
+    return record;
+}
+
+bool instance::occluded(const ray &r, float tmin, float tmax) const {
+    const auto [local, scale] = to_local(r);
+    return blas_->occluded(local, tmin * scale, tmax * scale);
+}
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <array>
+#include <execution>
+#include <numeric>
+
+#include "bvh.hpp"
+#include "parallel.hpp"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace {
+constexpr int morton_wide_threshold = 1 << 16;  // 图元数不少于此值时使用63位Morton码, 否则用30位
+constexpr int treelet_bits = 12;  // Morton码最高的若干位相同的图元组成一棵子树(treelet)
+
+struct morton_prim {
+    std::uint64_t code;
+    int index;
+};
+
+/**
+ * @brief 在value的低bits位中, 每一位之后插入两个0, 用于交错三个坐标的各位
+ */
+std::uint64_t spread_bits(std::uint64_t value, int bits) {
+    if (bits <= 10) {
+        value &= 0x3ffU;
+        value = (value | (value << 16U)) & 0x30000ffU;
+        value = (value | (value << 8U)) & 0x300f00fU;
+        value = (value | (value << 4U)) & 0x30c30c3U;
+        value = (value | (value << 2U)) & 0x9249249U;
+        return value;
+    }
+    value &= 0x1fffffU;
+    value = (value | (value << 32U)) & 0x1f00000000ffffULL;
+    value = (value | (value << 16U)) & 0x1f0000ff0000ffULL;
+    value = (value | (value << 8U)) & 0x100f00f00f00f00fULL;
+    value = (value | (value << 4U)) & 0x10c30c30c30c30c3ULL;
+    value = (value | (value << 2U)) & 0x1249249249249249ULL;
+    return value;
+}
+
+int leading_zeros(std::uint64_t value) {
+    if (value == 0) {
+        return 64;
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(value);
+#elif defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return 63 - (int)index;
+#else
+    int count = 0;
+    for (std::uint64_t mask = 1ULL << 63U; (value & mask) == 0; mask >>= 1U) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+/**
+ * @brief 按code的低key_bits位做LSD基数排序, 每趟处理8位.
+ * 各块并行统计直方图, 按(桶, 块)的顺序求前缀和之后再并行分发, 因此排序是稳定的
+ */
+void radix_sort(std::vector<morton_prim> &prims, int key_bits) {
+    constexpr int digit_bits = 8;
+    constexpr int n_buckets = 1 << digit_bits;
+    constexpr int block_size = bvh::parallel_threshold;
+    const auto n_prims = (int)prims.size();
+    const int n_blocks = (n_prims + block_size - 1) / block_size;
+    std::vector<int> blocks(n_blocks);
+    std::iota(blocks.begin(), blocks.end(), 0);
+    std::vector<std::array<int, n_buckets>> offsets(n_blocks);
+    std::vector<morton_prim> buffer(n_prims);
+
+    for (int shift = 0; shift < key_bits; shift += digit_bits) {
+        auto digit_of = [shift](const morton_prim &prim) {
+            return (int)((prim.code >> (unsigned)shift) & (n_buckets - 1U));
+        };
+        std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](int block) {
+            auto &counts = offsets[block];
+            counts.fill(0);
+            const int last = std::min(n_prims, (block + 1) * block_size);
+            for (int i = block * block_size; i < last; i++) {
+                counts[digit_of(prims[i])]++;
+            }
+        });
+        int sum = 0;
+        for (int bucket = 0; bucket < n_buckets; bucket++) {
+            for (auto &&counts : offsets) {
+                const int count = counts[bucket];
+                counts[bucket] = sum;
+                sum += count;
+            }
+        }
+        std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](int block) {
+            auto &next = offsets[block];
+            const int last = std::min(n_prims, (block + 1) * block_size);
+            for (int i = block * block_size; i < last; i++) {
+                buffer[next[digit_of(prims[i])]++] = prims[i];
+            }
+        });
+        prims.swap(buffer);
+    }
+}
+
+/**
+ * @brief 选择左右子节点中心相距最远的轴作为划分轴, 左子节点在此轴上靠近负方向
+ */
+int split_axis(const aabb &left, const aabb &right) {
+    const auto offset = right.centroid() - left.centroid();
+    int axis = 0;
+    if (offset.y() > offset[axis]) {
+        axis = 1;
+    }
+    if (offset.z() > offset[axis]) {
+        axis = 2;
+    }
+    return axis;
+}
+}  // namespace
+
+/**
+ * @brief 按Morton码排序后的图元构成的基数树(Karras 2012): n个图元对应n个叶子与n-1个内部节点,
+ * 每个内部节点覆盖排序后连续的一段图元, 且这一段的一端恰好是它自己的编号
+ */
+struct bvh::radix_tree {
+    static constexpr std::uint32_t leaf_flag = 1U << 31U;  // 带有此标记的编号表示叶子
+
+    std::uint32_t root{0};
+    std::vector<std::array<std::uint32_t, 2>> children;  // 内部节点的左右子节点
+    std::vector<std::pair<int, int>> ranges;             // 内部节点覆盖的图元范围[first, last]
+    std::vector<std::uint32_t> treelet_roots;            // 各子树(treelet)的根节点
+
+    [[nodiscard]] std::pair<int, int> range(std::uint32_t id) const {
+        if ((id & leaf_flag) != 0) {
+            const auto index = (int)(id & ~leaf_flag);
+            return {index, index};
+        }
+        return ranges[id];
+    }
+};
+
+auto bvh::build_linear(std::vector<prim_info> &infos) const -> node_chunks {
+    const auto n_prims = (int)infos.size();
+    std::vector<int> range(n_prims);
+    std::iota(range.begin(), range.end(), 0);
+    auto centroid_box = [](const prim_info &info) { return aabb{info.centroid, info.centroid}; };
+    auto merge = [](const aabb &box1, const aabb &box2) { return box1.union_with(box2); };
+    const auto centroid_bounds = std::transform_reduce(std::execution::par, infos.begin(),
+                                                       infos.end(), aabb{}, merge, centroid_box);
+
+    // 中心在包围盒内量化为每个轴10位或21位的整数, 三个轴的各位交错排列得到Morton码
+    const int axis_bits = n_prims < morton_wide_threshold ? 10 : 21;
+    const auto scale = (float)((1U << (unsigned)axis_bits) - 1);
+    std::vector<morton_prim> prims(n_prims);
+    std::for_each(std::execution::par, range.begin(), range.end(), [&](int index) {
+        std::uint64_t code = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            const float low = centroid_bounds.low()[axis];
+            const float extent = centroid_bounds.high()[axis] - low;
+            const float ratio = extent > 0 ? (infos[index].centroid[axis] - low) / extent : 0;
+            const auto quantized = (std::uint64_t)std::clamp(ratio * scale, 0.0F, scale);
+            code |= spread_bits(quantized, axis_bits) << (2U - (unsigned)axis);
+        }
+        prims[index] = {code, index};
+    });
+    radix_sort(prims, 3 * axis_bits);
+    {
+        std::vector<prim_info> sorted(n_prims);
+        std::for_each(std::execution::par, range.begin(), range.end(),
+                      [&](int index) { sorted[index] = infos[prims[index].index]; });
+        infos = std::move(sorted);
+    }
+
+    // 各内部节点互不依赖, 可以完全并行地确定它覆盖的范围与左右子节点
+    radix_tree tree;
+    tree.root = n_prims == 1 ? radix_tree::leaf_flag : 0;
+    tree.children.resize(n_prims - 1);
+    tree.ranges.resize(n_prims - 1);
+    // 两个键的公共前缀长度; 键相同时比较下标, 相当于所有键互不相同
+    auto delta = [&](int i, int j) {
+        if (j < 0 || j >= n_prims) {
+            return -1;
+        }
+        const auto diff = prims[i].code ^ prims[j].code;
+        if (diff == 0) {
+            return 64 + leading_zeros((std::uint64_t)(i ^ j));
+        }
+        return leading_zeros(diff);
+    };
+    std::for_each(std::execution::par, range.begin(), range.end() - 1, [&](int i) {
+        // 范围从i出发朝与相邻键公共前缀更长的方向d延伸, 先倍增再二分找到另一端j
+        const int d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+        const int delta_min = delta(i, i - d);
+        int length_max = 2;
+        while (delta(i, i + length_max * d) > delta_min) {
+            length_max *= 2;
+        }
+        int length = 0;
+        for (int step = length_max / 2; step >= 1; step /= 2) {
+            if (delta(i, i + (length + step) * d) > delta_min) {
+                length += step;
+            }
+        }
+        const int j = i + length * d;
+
+        // 再二分找到范围内公共前缀变短的位置, 即左右子节点的分界gamma
+        const int delta_node = delta(i, j);
+        int offset = 0;
+        int step = length;
+        do {
+            step = (step + 1) / 2;
+            if (delta(i, i + (offset + step) * d) > delta_node) {
+                offset += step;
+            }
+        } while (step > 1);
+        const int gamma = i + offset * d + std::min(d, 0);
+
+        const int first = std::min(i, j);
+        const int last = std::max(i, j);
+        tree.children[i] = {
+            first == gamma ? radix_tree::leaf_flag | gamma : (std::uint32_t)gamma,
+            last == gamma + 1 ? radix_tree::leaf_flag | (gamma + 1) : (std::uint32_t)gamma + 1};
+        tree.ranges[i] = {first, last};
+    });
+
+    if (!config_.lbvh_sah_top) {
+        return emit_parallel(tree, infos, tree.root, 0);
+    }
+
+    // Morton码高位相同的图元在基数树中恰好组成一棵子树, 这些子树之上的层次按SAH重建(HLBVH)
+    const int shift = 3 * axis_bits - treelet_bits;
+    std::vector<std::pair<int, int>> groups;
+    auto prefix = [&](int index) { return prims[index].code >> (unsigned)shift; };
+    for (int i = 0; i < n_prims; i++) {
+        if (i == 0 || prefix(i) != prefix(i - 1)) {
+            groups.emplace_back(i, i);
+        }
+        groups.back().second = i;
+    }
+    const auto n_groups = (int)groups.size();
+    std::vector<prim_info> treelets(n_groups);
+    tree.treelet_roots.resize(n_groups);
+    std::vector<int> group_range(n_groups);
+    std::iota(group_range.begin(), group_range.end(), 0);
+    std::for_each(std::execution::par, group_range.begin(), group_range.end(), [&](int group) {
+        const auto [first, last] = groups[group];
+        aabb bounds;
+        for (int i = first; i <= last; i++) {
+            bounds = bounds.union_with(infos[i].bounding);
+        }
+        treelets[group] = {bounds, bounds.centroid(), group};
+        if (first == last) {
+            tree.treelet_roots[group] = radix_tree::leaf_flag | first;
+        } else {
+            tree.treelet_roots[group] = tree.ranges[first] == groups[group] ? first : last;
+        }
+    });
+    return emit_upper(tree, infos, treelets, 0, n_groups, 0);
+}
+
+float bvh::emit_serial(const radix_tree &tree, std::vector<bvh_node> &nodes,
+                       std::vector<prim_info> &infos, std::uint32_t id, int depth) const {
+    const auto [first, last] = tree.range(id);
+    const int span = last - first + 1;
+    if ((id & radix_tree::leaf_flag) != 0) {
+        bvh_node leaf;
+        leaf.bounding = infos[first].bounding;
+        leaf.offset = first;
+        leaf.count = 1;
+        nodes.push_back(leaf);
+        return config_.cost_ratio;
+    }
+    if (depth >= max_depth / 2) {
+        // 基数树可能很不平衡, 过深的子树改由build_serial按中位数划分
+        build_serial(nodes, infos, first, last + 1, depth);
+        return config_.cost_ratio * (float)span;  // 粗略的估计, 只用于判断上层是否合并为叶节点
+    }
+
+    const auto index = nodes.size();
+    nodes.emplace_back();
+    const float cost_left = emit_serial(tree, nodes, infos, tree.children[id][0], depth + 1);
+    const auto right = nodes.size();
+    const float cost_right = emit_serial(tree, nodes, infos, tree.children[id][1], depth + 1);
+
+    const auto left_bounds = nodes[index + 1].bounding;
+    const auto right_bounds = nodes[right].bounding;
+    const auto bounds = left_bounds.union_with(right_bounds);
+    const float area = bounds.area();
+    const float leaf_cost = config_.cost_ratio * (float)span;
+    const float split_cost =
+        area > 0 ? 1 + (left_bounds.area() * cost_left + right_bounds.area() * cost_right) / area
+                 : leaf_cost;
+    if (span <= config_.max_leaf_size && leaf_cost <= split_cost) {
+        nodes.resize(index + 1);
+        auto &leaf = nodes[index];
+        leaf.bounding = bounds;
+        leaf.offset = first;
+        leaf.count = span;
+        return leaf_cost;
+    }
+    auto &node = nodes[index];
+    node.bounding = bounds;
+    node.offset = right - index;
+    node.axis = split_axis(left_bounds, right_bounds);
+    return split_cost;
+}
+
+auto bvh::emit_parallel(const radix_tree &tree, std::vector<prim_info> &infos, std::uint32_t id,
+                        int depth) const -> node_chunks {
+    const auto [first, last] = tree.range(id);
+    const int span = last - first + 1;
+    if (span < parallel_threshold) {
+        node_chunks chunks(1);
+        chunks[0].reserve(2 * span - 1);
+        emit_serial(tree, chunks[0], infos, id, depth);
+        return chunks;
+    }
+    if (depth >= max_depth / 2) {
+        return build_parallel(infos, first, last + 1, depth);
+    }
+
+    std::array<node_chunks, 2> children;
+    auto emit_side = [&](int side) {
+        children[side] = emit_parallel(tree, infos, tree.children[id][side], depth + 1);
+    };
+    fork_join([&] { emit_side(0); }, [&] { emit_side(1); });
+    const int axis =
+        split_axis(children[0].front().front().bounding, children[1].front().front().bounding);
+    return join_chunks(children, axis);
+}
+
+auto bvh::emit_upper(const radix_tree &tree, std::vector<prim_info> &infos,
+                     std::vector<prim_info> &treelets, int start, int end, int depth) const
+    -> node_chunks {
+    if (end - start == 1) {
+        return emit_parallel(tree, infos, tree.treelet_roots[treelets[start].index], depth);
+    }
+    const auto [mid, axis] = partition(treelets, start, end, depth, false).value();
+    const std::array<std::pair<int, int>, 2> ranges = {{{start, mid}, {mid, end}}};
+    std::array<node_chunks, 2> children;
+    auto emit_side = [&](int side) {
+        children[side] = emit_upper(tree, infos, treelets, ranges[side].first,
+                                    ranges[side].second, depth + 1);
+    };
+    fork_join([&] { emit_side(0); }, [&] { emit_side(1); });
+    return join_chunks(children, axis);
+}
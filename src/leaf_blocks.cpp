@@ -0,0 +1,622 @@
+#include "leaf_blocks.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "ray.hpp"
+#include "simd.hpp"
+
+namespace {
+/**
+ * @brief 光线与块中全部三角形求交(Möller–Trumbore算法, 与intersect_triangle的运算顺序相同).
+ * 通用的标量实现, 用于没有相应SIMD指令集的平台
+ */
+template <int Width>
+struct block_kernel {
+    point_t origin;
+    vec3_t direction;
+
+    explicit block_kernel(const ray &r) : origin(r.origin()), direction(r.direction()) {}
+
+    /**
+     * @param t, u, v 输出每个lane的交点参数与重心坐标(对应第二、第三个顶点)
+     * @return 第i位表示光线在[tmin, tmax]内与第i个三角形相交
+     */
+    int operator()(const triangle_block<Width> &block, float tmin, float tmax,
+                   std::array<float, Width> &t, std::array<float, Width> &u,
+                   std::array<float, Width> &v) const {
+        int mask = 0;
+        for (int lane = 0; lane < Width; lane++) {
+            const vec3_t edge1{block.edge1[0][lane], block.edge1[1][lane], block.edge1[2][lane]};
+            const vec3_t edge2{block.edge2[0][lane], block.edge2[1][lane], block.edge2[2][lane]};
+            const point_t vertex0{block.vertex0[0][lane], block.vertex0[1][lane],
+                                  block.vertex0[2][lane]};
+            const vec3_t pvec = direction.cross(edge2);
+            const float det = edge1.dot(pvec);
+            const float inv_det = 1.0F / det;
+            const vec3_t tvec = origin - vertex0;
+            const vec3_t qvec = tvec.cross(edge1);
+            u[lane] = tvec.dot(pvec) * inv_det;
+            v[lane] = direction.dot(qvec) * inv_det;
+            t[lane] = edge2.dot(qvec) * inv_det;
+            const bool valid = det != 0 && u[lane] >= 0 && u[lane] <= 1 && v[lane] >= 0 &&
+                               u[lane] + v[lane] <= 1 && t[lane] >= tmin && t[lane] <= tmax;
+            mask |= (valid ? 1 : 0) << lane;
+        }
+        return mask;
+    }
+};
+
+/**
+ * @brief 光线与块中全部球面求交, 与intersect_sphere的运算顺序相同; 只求交点参数,
+ * 交点的参数坐标等留给最近的球面计算. 通用的标量实现
+ */
+template <int Width>
+struct sphere_kernel {
+    point_t origin;
+    vec3_t direction;
+
+    explicit sphere_kernel(const ray &r) : origin(r.origin()), direction(r.direction()) {}
+
+    /**
+     * @param t 输出每个lane在[tmin, tmax]内最近交点的参数
+     * @return 第i位表示光线在[tmin, tmax]内与第i个球面相交
+     */
+    int operator()(const sphere_block<Width> &block, float tmin, float tmax,
+                   std::array<float, Width> &t) const {
+        int mask = 0;
+        for (int lane = 0; lane < Width; lane++) {
+            const point_t center{block.center[0][lane], block.center[1][lane],
+                                 block.center[2][lane]};
+            const float radius = block.radius[lane];
+            const vec3_t oc = origin - center;
+            const float b_half = oc.dot(direction);
+            const float c = oc.len_sq() - radius * radius;
+            const float discriminant = b_half * b_half - c;
+            const float sqrtd = std::sqrt(discriminant);
+            const float root_near = -b_half - sqrtd;
+            const float root_far = -b_half + sqrtd;
+            const bool near_valid = root_near >= tmin && root_near <= tmax;
+            const bool far_valid = root_far >= tmin && root_far <= tmax;
+            t[lane] = near_valid ? root_near : root_far;
+            const bool valid = discriminant >= 0 && (near_valid || far_valid);
+            mask |= (valid ? 1 : 0) << lane;
+        }
+        return mask;
+    }
+};
+
+#ifdef RT_SIMD_SSE
+// 三个分量各占一个SIMD寄存器, 每个lane是一个三角形
+struct sse_vec3 {
+    __m128 e[3];
+
+    __m128 &operator[](int i) { return e[i]; }
+
+    const __m128 &operator[](int i) const { return e[i]; }
+};
+
+inline __m128 dot(const sse_vec3 &a, const sse_vec3 &b) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+                      _mm_mul_ps(a[2], b[2]));
+}
+
+inline sse_vec3 cross(const sse_vec3 &a, const sse_vec3 &b) {
+    return {_mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1])),
+            _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2])),
+            _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]))};
+}
+
+inline sse_vec3 load(const std::array<std::array<float, 4>, 3> &lanes) {
+    return {_mm_load_ps(lanes[0].data()), _mm_load_ps(lanes[1].data()),
+            _mm_load_ps(lanes[2].data())};
+}
+
+template <>
+struct block_kernel<4> {
+    sse_vec3 origin;  // 预先广播到SIMD寄存器中
+    sse_vec3 direction;
+
+    explicit block_kernel(const ray &r) {
+        const auto org = r.origin();
+        const auto dir = r.direction();
+        for (int i = 0; i < 3; i++) {
+            origin[i] = _mm_set1_ps(org[i]);
+            direction[i] = _mm_set1_ps(dir[i]);
+        }
+    }
+
+    int operator()(const triangle_block<4> &block, float tmin, float tmax,
+                   std::array<float, 4> &t, std::array<float, 4> &u,
+                   std::array<float, 4> &v) const {
+        const auto edge1 = load(block.edge1);
+        const auto edge2 = load(block.edge2);
+        const auto vertex0 = load(block.vertex0);
+        const auto pvec = cross(direction, edge2);
+        const __m128 det = dot(edge1, pvec);
+        const __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0F), det);
+        const sse_vec3 tvec = {_mm_sub_ps(origin[0], vertex0[0]), _mm_sub_ps(origin[1], vertex0[1]),
+                               _mm_sub_ps(origin[2], vertex0[2])};
+        const auto qvec = cross(tvec, edge1);
+        const __m128 vu = _mm_mul_ps(dot(tvec, pvec), inv_det);
+        const __m128 vv = _mm_mul_ps(dot(direction, qvec), inv_det);
+        const __m128 vt = _mm_mul_ps(dot(edge2, qvec), inv_det);
+        // 有序比较: 出现NaN的lane一律视为不相交
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0F);
+        __m128 valid = _mm_cmpneq_ps(det, zero);
+        valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(vu, zero), _mm_cmple_ps(vu, one)));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(vv, zero));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(vu, vv), one));
+        valid = _mm_and_ps(valid, _mm_cmpge_ps(vt, _mm_set1_ps(tmin)));
+        valid = _mm_and_ps(valid, _mm_cmple_ps(vt, _mm_set1_ps(tmax)));
+        _mm_storeu_ps(t.data(), vt);
+        _mm_storeu_ps(u.data(), vu);
+        _mm_storeu_ps(v.data(), vv);
+        return _mm_movemask_ps(valid);
+    }
+};
+
+template <>
+struct sphere_kernel<4> {
+    sse_vec3 origin;
+    sse_vec3 direction;
+
+    explicit sphere_kernel(const ray &r) {
+        const auto org = r.origin();
+        const auto dir = r.direction();
+        for (int i = 0; i < 3; i++) {
+            origin[i] = _mm_set1_ps(org[i]);
+            direction[i] = _mm_set1_ps(dir[i]);
+        }
+    }
+
+    int operator()(const sphere_block<4> &block, float tmin, float tmax,
+                   std::array<float, 4> &t) const {
+        const auto center = load(block.center);
+        const sse_vec3 oc = {_mm_sub_ps(origin[0], center[0]), _mm_sub_ps(origin[1], center[1]),
+                             _mm_sub_ps(origin[2], center[2])};
+        const __m128 radius = _mm_load_ps(block.radius.data());
+        const __m128 b_half = dot(oc, direction);
+        const __m128 c = _mm_sub_ps(dot(oc, oc), _mm_mul_ps(radius, radius));
+        const __m128 discriminant = _mm_sub_ps(_mm_mul_ps(b_half, b_half), c);
+        // 判别式为负的lane开方得到NaN, 之后的有序比较都不成立
+        const __m128 sqrtd = _mm_sqrt_ps(discriminant);
+        const __m128 neg_b = _mm_xor_ps(b_half, _mm_set1_ps(-0.0F));
+        const __m128 root_near = _mm_sub_ps(neg_b, sqrtd);
+        const __m128 root_far = _mm_add_ps(neg_b, sqrtd);
+        const __m128 lower = _mm_set1_ps(tmin);
+        const __m128 upper = _mm_set1_ps(tmax);
+        const __m128 near_valid =
+            _mm_and_ps(_mm_cmpge_ps(root_near, lower), _mm_cmple_ps(root_near, upper));
+        const __m128 far_valid =
+            _mm_and_ps(_mm_cmpge_ps(root_far, lower), _mm_cmple_ps(root_far, upper));
+        const __m128 vt =
+            _mm_or_ps(_mm_and_ps(near_valid, root_near), _mm_andnot_ps(near_valid, root_far));
+        const __m128 valid = _mm_and_ps(_mm_cmpge_ps(discriminant, _mm_setzero_ps()),
+                                        _mm_or_ps(near_valid, far_valid));
+        _mm_storeu_ps(t.data(), vt);
+        return _mm_movemask_ps(valid);
+    }
+};
+#endif
+
+#ifdef RT_SIMD_AVX2
+struct avx_vec3 {
+    __m256 e[3];
+
+    __m256 &operator[](int i) { return e[i]; }
+
+    const __m256 &operator[](int i) const { return e[i]; }
+};
+
+RT_TARGET_AVX2 inline __m256 dot(const avx_vec3 &a, const avx_vec3 &b) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], b[0]), _mm256_mul_ps(a[1], b[1])),
+                         _mm256_mul_ps(a[2], b[2]));
+}
+
+RT_TARGET_AVX2 inline avx_vec3 cross(const avx_vec3 &a, const avx_vec3 &b) {
+    return {_mm256_sub_ps(_mm256_mul_ps(a[1], b[2]), _mm256_mul_ps(a[2], b[1])),
+            _mm256_sub_ps(_mm256_mul_ps(a[2], b[0]), _mm256_mul_ps(a[0], b[2])),
+            _mm256_sub_ps(_mm256_mul_ps(a[0], b[1]), _mm256_mul_ps(a[1], b[0]))};
+}
+
+RT_TARGET_AVX2 inline avx_vec3 load(const std::array<std::array<float, 8>, 3> &lanes) {
+    return {_mm256_load_ps(lanes[0].data()), _mm256_load_ps(lanes[1].data()),
+            _mm256_load_ps(lanes[2].data())};
+}
+
+template <>
+struct block_kernel<8> {
+    avx_vec3 origin;
+    avx_vec3 direction;
+
+    RT_TARGET_AVX2 explicit block_kernel(const ray &r) {
+        const auto org = r.origin();
+        const auto dir = r.direction();
+        for (int i = 0; i < 3; i++) {
+            origin[i] = _mm256_set1_ps(org[i]);
+            direction[i] = _mm256_set1_ps(dir[i]);
+        }
+    }
+
+    RT_TARGET_AVX2 int operator()(const triangle_block<8> &block, float tmin, float tmax,
+                                  std::array<float, 8> &t, std::array<float, 8> &u,
+                                  std::array<float, 8> &v) const {
+        const auto edge1 = load(block.edge1);
+        const auto edge2 = load(block.edge2);
+        const auto vertex0 = load(block.vertex0);
+        const auto pvec = cross(direction, edge2);
+        const __m256 det = dot(edge1, pvec);
+        const __m256 inv_det = _mm256_div_ps(_mm256_set1_ps(1.0F), det);
+        const avx_vec3 tvec = {_mm256_sub_ps(origin[0], vertex0[0]),
+                               _mm256_sub_ps(origin[1], vertex0[1]),
+                               _mm256_sub_ps(origin[2], vertex0[2])};
+        const auto qvec = cross(tvec, edge1);
+        const __m256 vu = _mm256_mul_ps(dot(tvec, pvec), inv_det);
+        const __m256 vv = _mm256_mul_ps(dot(direction, qvec), inv_det);
+        const __m256 vt = _mm256_mul_ps(dot(edge2, qvec), inv_det);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0F);
+        __m256 valid = _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ);
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(vu, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(vu, one, _CMP_LE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(vv, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(vu, vv), one, _CMP_LE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(vt, _mm256_set1_ps(tmin), _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(vt, _mm256_set1_ps(tmax), _CMP_LE_OQ));
+        _mm256_storeu_ps(t.data(), vt);
+        _mm256_storeu_ps(u.data(), vu);
+        _mm256_storeu_ps(v.data(), vv);
+        return _mm256_movemask_ps(valid);
+    }
+};
+
+template <>
+struct sphere_kernel<8> {
+    avx_vec3 origin;
+    avx_vec3 direction;
+
+    RT_TARGET_AVX2 explicit sphere_kernel(const ray &r) {
+        const auto org = r.origin();
+        const auto dir = r.direction();
+        for (int i = 0; i < 3; i++) {
+            origin[i] = _mm256_set1_ps(org[i]);
+            direction[i] = _mm256_set1_ps(dir[i]);
+        }
+    }
+
+    RT_TARGET_AVX2 int operator()(const sphere_block<8> &block, float tmin, float tmax,
+                                  std::array<float, 8> &t) const {
+        const auto center = load(block.center);
+        const avx_vec3 oc = {_mm256_sub_ps(origin[0], center[0]),
+                             _mm256_sub_ps(origin[1], center[1]),
+                             _mm256_sub_ps(origin[2], center[2])};
+        const __m256 radius = _mm256_load_ps(block.radius.data());
+        const __m256 b_half = dot(oc, direction);
+        const __m256 c = _mm256_sub_ps(dot(oc, oc), _mm256_mul_ps(radius, radius));
+        const __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b_half, b_half), c);
+        const __m256 sqrtd = _mm256_sqrt_ps(discriminant);
+        const __m256 neg_b = _mm256_xor_ps(b_half, _mm256_set1_ps(-0.0F));
+        const __m256 root_near = _mm256_sub_ps(neg_b, sqrtd);
+        const __m256 root_far = _mm256_add_ps(neg_b, sqrtd);
+        const __m256 lower = _mm256_set1_ps(tmin);
+        const __m256 upper = _mm256_set1_ps(tmax);
+        const __m256 near_valid = _mm256_and_ps(_mm256_cmp_ps(root_near, lower, _CMP_GE_OQ),
+                                                _mm256_cmp_ps(root_near, upper, _CMP_LE_OQ));
+        const __m256 far_valid = _mm256_and_ps(_mm256_cmp_ps(root_far, lower, _CMP_GE_OQ),
+                                               _mm256_cmp_ps(root_far, upper, _CMP_LE_OQ));
+        const __m256 vt = _mm256_blendv_ps(root_far, root_near, near_valid);
+        const __m256 valid =
+            _mm256_and_ps(_mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ),
+                          _mm256_or_ps(near_valid, far_valid));
+        _mm256_storeu_ps(t.data(), vt);
+        return _mm256_movemask_ps(valid);
+    }
+};
+#endif
+
+/**
+ * @brief 从网格的顶点与索引缓冲区读取第first个面开始的count(不超过Width)个面, 装入三角形块.
+ * 其余lane保持零向量, 行列式为0, 不会与光线相交
+ */
+template <int Width>
+void gather(const triangle_mesh &mesh, std::uint32_t first, std::uint32_t count,
+            triangle_block<Width> &block) {
+    block = {};
+    for (std::uint32_t lane = 0; lane < count; lane++) {
+        const auto points = mesh.vertices(first + lane);
+        const auto edge1 = points[1] - points[0];
+        const auto edge2 = points[2] - points[0];
+        for (int axis = 0; axis < 3; axis++) {
+            block.vertex0[axis][lane] = points[0][axis];
+            block.edge1[axis][lane] = edge1[axis];
+            block.edge2[axis][lane] = edge2[axis];
+        }
+    }
+}
+
+/**
+ * @brief 与网格中[first, first + count)范围内的面求交, 找到更近的交点时更新tmax与res
+ */
+template <int Width>
+void intersect_faces(const triangle_mesh &mesh, std::uint32_t first, std::uint32_t count,
+                     const ray &r, float tmin, float &tmax, isect_res_t &res) {
+    // 先找出最近的面, 最后只为它记录一次交点
+    const block_kernel<Width> kernel{r};
+    std::uint32_t nearest = 0;
+    bool found = false;
+    std::array<float, 2> bary{};
+    for (std::uint32_t base = first; base < first + count; base += Width) {
+        triangle_block<Width> block;
+        gather(mesh, base, std::min<std::uint32_t>(Width, first + count - base), block);
+        std::array<float, Width> t{};
+        std::array<float, Width> u{};
+        std::array<float, Width> v{};
+        const int mask = kernel(block, tmin, tmax, t, u, v);
+        for (int lane = 0; lane < Width; lane++) {
+            if ((mask & (1 << lane)) != 0 && t[lane] <= tmax) {
+                tmax = t[lane];
+                nearest = base + lane;
+                bary = {u[lane], v[lane]};
+                found = true;
+            }
+        }
+    }
+    if (found) {
+        res = intersection{tmax, bary, nearest, &mesh};
+    }
+}
+
+template <int Width>
+bool faces_occluded(const triangle_mesh &mesh, std::uint32_t first, std::uint32_t count,
+                    const ray &r, float tmin, float tmax) {
+    const block_kernel<Width> kernel{r};
+    for (std::uint32_t base = first; base < first + count; base += Width) {
+        triangle_block<Width> block;
+        gather(mesh, base, std::min<std::uint32_t>(Width, first + count - base), block);
+        std::array<float, Width> t{};
+        std::array<float, Width> u{};
+        std::array<float, Width> v{};
+        if (kernel(block, tmin, tmax, t, u, v) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 读取world_t::spheres中从first开始的count(不超过Width)个球面, 装入球面块.
+ * 其余lane的球心为NaN
+ */
+template <int Width>
+void gather(const std::vector<sphere> &spheres, std::uint32_t first, std::uint32_t count,
+            sphere_block<Width> &block) {
+    for (auto &axis : block.center) {
+        axis.fill(std::numeric_limits<float>::quiet_NaN());
+    }
+    block.radius.fill(0);
+    for (std::uint32_t lane = 0; lane < count; lane++) {
+        const auto &ball = spheres[first + lane];
+        for (int axis = 0; axis < 3; axis++) {
+            block.center[axis][lane] = ball.center()[axis];
+        }
+        block.radius[lane] = ball.radius();
+    }
+}
+
+/**
+ * @brief 与[first, first + count)范围内的球面求交, 找到更近的交点时更新tmax与res
+ */
+template <int Width>
+void intersect_spheres(const std::vector<sphere> &spheres, std::uint32_t first,
+                       std::uint32_t count, const ray &r, float tmin, float &tmax,
+                       isect_res_t &res) {
+    // 球面的参数坐标需要反三角函数, 同样只在surface_interaction中为最近的交点计算
+    const sphere_kernel<Width> kernel{r};
+    std::uint32_t nearest = 0;
+    bool found = false;
+    for (std::uint32_t base = first; base < first + count; base += Width) {
+        sphere_block<Width> block;
+        gather(spheres, base, std::min<std::uint32_t>(Width, first + count - base), block);
+        std::array<float, Width> t{};
+        const int mask = kernel(block, tmin, tmax, t);
+        for (int lane = 0; lane < Width; lane++) {
+            if ((mask & (1 << lane)) != 0 && t[lane] <= tmax) {
+                tmax = t[lane];
+                nearest = base + lane;
+                found = true;
+            }
+        }
+    }
+    if (found) {
+        res = intersection{tmax, {}, 0, &spheres[nearest]};
+    }
+}
+
+template <int Width>
+bool spheres_occluded(const std::vector<sphere> &spheres, std::uint32_t first,
+                      std::uint32_t count, const ray &r, float tmin, float tmax) {
+    const sphere_kernel<Width> kernel{r};
+    for (std::uint32_t base = first; base < first + count; base += Width) {
+        sphere_block<Width> block;
+        gather(spheres, base, std::min<std::uint32_t>(Width, first + count - base), block);
+        std::array<float, Width> t{};
+        if (kernel(block, tmin, tmax, t) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 与[first, first + count)范围内的矩形逐个求交, 直接调用intersect_rectangle而不经过虚函数
+ */
+void intersect_rectangles(const std::vector<rectangle> &rectangles, std::uint32_t first,
+                          std::uint32_t count, const ray &r, float tmin, float &tmax,
+                          isect_res_t &res) {
+    for (std::uint32_t i = first; i < first + count; i++) {
+        const auto &rect = rectangles[i];
+        tex_coords_t tex_coords;
+        const auto t = intersect_rectangle(r, rect.corner(), rect.edge_u(), rect.edge_v(),
+                                           rect.normal(), tmin, tmax, tex_coords);
+        if (t.has_value()) {
+            tmax = t.value();
+            res = intersection{tmax, tex_coords, 0, &rect};
+        }
+    }
+}
+
+bool rectangles_occluded(const std::vector<rectangle> &rectangles, std::uint32_t first,
+                         std::uint32_t count, const ray &r, float tmin, float tmax) {
+    return std::any_of(rectangles.begin() + first, rectangles.begin() + first + count,
+                       [&](const rectangle &rect) {
+                           tex_coords_t tex_coords;
+                           return intersect_rectangle(r, rect.corner(), rect.edge_u(),
+                                                      rect.edge_v(), rect.normal(), tmin, tmax,
+                                                      tex_coords)
+                               .has_value();
+                       });
+}
+
+/**
+ * @brief 与world中一类图元的[first, first + count)范围求交, 找到更近的交点时更新tmax与res
+ */
+template <int Width>
+void intersect_range(const world_t &world, prim_kind kind, std::uint32_t first,
+                     std::uint32_t count, const ray &r, float tmin, float &tmax,
+                     isect_res_t &res) {
+    if (kind == prim_kind::triangle) {
+        intersect_faces<Width>(world.mesh, first, count, r, tmin, tmax, res);
+        return;
+    }
+    if (kind == prim_kind::sphere) {
+        intersect_spheres<Width>(world.spheres, first, count, r, tmin, tmax, res);
+        return;
+    }
+    if (kind == prim_kind::rectangle) {
+        intersect_rectangles(world.rectangles, first, count, r, tmin, tmax, res);
+        return;
+    }
+    for (std::uint32_t i = first; i < first + count; i++) {
+        const auto isect = world.objects[i]->intersect(r, tmin, tmax);
+        if (isect.has_value()) {
+            tmax = isect->ray_param;
+            res = isect;
+        }
+    }
+}
+
+template <int Width>
+bool range_occluded(const world_t &world, prim_kind kind, std::uint32_t first,
+                    std::uint32_t count, const ray &r, float tmin, float tmax) {
+    if (kind == prim_kind::triangle) {
+        return faces_occluded<Width>(world.mesh, first, count, r, tmin, tmax);
+    }
+    if (kind == prim_kind::sphere) {
+        return spheres_occluded<Width>(world.spheres, first, count, r, tmin, tmax);
+    }
+    if (kind == prim_kind::rectangle) {
+        return rectangles_occluded(world.rectangles, first, count, r, tmin, tmax);
+    }
+    return std::any_of(world.objects.begin() + first, world.objects.begin() + first + count,
+                       [&](const std::shared_ptr<hittable> &object) {
+                           return object->occluded(r, tmin, tmax);
+                       });
+}
+
+/**
+ * @brief 与一个叶节点中的全部图元求交, 见leaf_blocks::intersect()
+ */
+template <int Width>
+isect_res_t intersect_leaf(const world_t &world, const std::vector<leaf_ranges> &mixed,
+                           prim_kind kind, std::uint32_t offset, std::uint32_t count,
+                           const ray &r, float tmin, float tmax) {
+    isect_res_t res = std::nullopt;
+    if (kind != prim_kind::mixed) {
+        intersect_range<Width>(world, kind, offset, count, r, tmin, tmax, res);
+        return res;
+    }
+    const auto &ranges = mixed[offset];
+    for (int k = 0; k < n_prim_kinds; k++) {
+        if (ranges.count[k] > 0) {
+            intersect_range<Width>(world, (prim_kind)k, ranges.first[k], ranges.count[k], r,
+                                   tmin, tmax, res);
+        }
+    }
+    return res;
+}
+
+template <int Width>
+bool leaf_occluded(const world_t &world, const std::vector<leaf_ranges> &mixed, prim_kind kind,
+                   std::uint32_t offset, std::uint32_t count, const ray &r, float tmin,
+                   float tmax) {
+    if (kind != prim_kind::mixed) {
+        return range_occluded<Width>(world, kind, offset, count, r, tmin, tmax);
+    }
+    const auto &ranges = mixed[offset];
+    for (int k = 0; k < n_prim_kinds; k++) {
+        if (ranges.count[k] > 0 && range_occluded<Width>(world, (prim_kind)k, ranges.first[k],
+                                                         ranges.count[k], r, tmin, tmax)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef RT_SIMD_AVX2
+// flatten使装入块的循环与8宽的求交核一起内联, 整个叶节点按AVX2编译
+RT_TARGET_AVX2 RT_FLATTEN isect_res_t intersect_leaf_avx2(const world_t &world,
+                                                          const std::vector<leaf_ranges> &mixed,
+                                                          prim_kind kind, std::uint32_t offset,
+                                                          std::uint32_t count, const ray &r,
+                                                          float tmin, float tmax) {
+    return intersect_leaf<8>(world, mixed, kind, offset, count, r, tmin, tmax);
+}
+
+RT_TARGET_AVX2 RT_FLATTEN bool leaf_occluded_avx2(const world_t &world,
+                                                  const std::vector<leaf_ranges> &mixed,
+                                                  prim_kind kind, std::uint32_t offset,
+                                                  std::uint32_t count, const ray &r, float tmin,
+                                                  float tmax) {
+    return leaf_occluded<8>(world, mixed, kind, offset, count, r, tmin, tmax);
+}
+#endif
+}  // namespace
+
+template <int Width>
+isect_res_t leaf_blocks<Width>::intersect(prim_kind kind, std::uint32_t offset,
+                                          std::uint32_t count, const ray &r, float tmin,
+                                          float tmax) const {
+    return intersect_leaf<Width>(*world_, *mixed_, kind, offset, count, r, tmin, tmax);
+}
+
+template <>
+isect_res_t leaf_blocks<8>::intersect(prim_kind kind, std::uint32_t offset, std::uint32_t count,
+                                      const ray &r, float tmin, float tmax) const {
+#ifdef RT_SIMD_AVX2
+    return intersect_leaf_avx2(*world_, *mixed_, kind, offset, count, r, tmin, tmax);
+#else
+    return intersect_leaf<8>(*world_, *mixed_, kind, offset, count, r, tmin, tmax);
+#endif
+}
+
+template <int Width>
+bool leaf_blocks<Width>::occluded(prim_kind kind, std::uint32_t offset, std::uint32_t count,
+                                  const ray &r, float tmin, float tmax) const {
+    return leaf_occluded<Width>(*world_, *mixed_, kind, offset, count, r, tmin, tmax);
+}
+
+template <>
+bool leaf_blocks<8>::occluded(prim_kind kind, std::uint32_t offset, std::uint32_t count,
+                              const ray &r, float tmin, float tmax) const {
+#ifdef RT_SIMD_AVX2
+    return leaf_occluded_avx2(*world_, *mixed_, kind, offset, count, r, tmin, tmax);
+#else
+    return leaf_occluded<8>(*world_, *mixed_, kind, offset, count, r, tmin, tmax);
+#endif
+}
+
+template class leaf_blocks<4>;
+template class leaf_blocks<8>;
@@ -13,14 +13,18 @@ int main(int argc, char *argv[]) {
     std::cout << "program started...\n\n";
     auto start = std::chrono::steady_clock::now();
     parser my_parser{argv[1]};
-    auto world = my_parser.make_scene();
     auto my_tracer = my_parser.make_tracer();
+    auto my_scene = my_parser.make_scene();
 
-    std::filesystem::path image_path(argv[2]);
-    exist_or_abort(image_path, "image directory");
-    image_path /= (current_time() + ".png");
-
-    my_tracer.trace(world, image_path.string());
+    const std::filesystem::path image_dir(argv[2]);
+    exist_or_abort(image_dir, "image directory");
+    const auto image_name = current_time();
+    const int frames = my_parser.frame_count();
+    for (int frame = 0; frame < frames; frame++) {
+        const auto suffix = frames > 1 ? "-" + std::to_string(frame) : "";
+        my_tracer.trace(my_scene.frame(frame),
+                        (image_dir / (image_name + suffix + ".png")).string());
+    }
     auto end = std::chrono::steady_clock::now();
     std::cout << "done in " << std::chrono::duration<double>(end - start).count() << "s.\n";
     return 0;
@@ -0,0 +1,48 @@
+#include "packed_world.hpp"
+
+#include <algorithm>
+#include <vector>
+
+template <int Width>
+packed_world<Width>::packed_world(std::shared_ptr<const world_t> world) {
+    for (int k = 0; k < n_prim_kinds; k++) {
+        n_prims_[k] = (std::uint32_t)world->size((prim_kind)k);
+    }
+    // 每组相当于一个只有范围有效的叶节点, 不会出现mixed类型
+    leaves_ = leaf_blocks<Width>{std::move(world),
+                                 std::make_shared<const std::vector<leaf_ranges>>()};
+}
+
+template <int Width>
+isect_res_t packed_world<Width>::intersect(const ray &r, float tmin, float tmax) const {
+    isect_res_t res = std::nullopt;
+    for (int k = 0; k < n_prim_kinds; k++) {
+        const auto n_prims = n_prims_[k];
+        for (std::uint32_t offset = 0; offset < n_prims; offset += group_size) {
+            const auto count = std::min(group_size, n_prims - offset);
+            const auto isect = leaves_.intersect((prim_kind)k, offset, count, r, tmin, tmax);
+            if (isect.has_value()) {
+                tmax = isect->ray_param;
+                res = isect;
+            }
+        }
+    }
+    return res;
+}
+
+template <int Width>
+bool packed_world<Width>::occluded(const ray &r, float tmin, float tmax) const {
+    for (int k = 0; k < n_prim_kinds; k++) {
+        const auto n_prims = n_prims_[k];
+        for (std::uint32_t offset = 0; offset < n_prims; offset += group_size) {
+            const auto count = std::min(group_size, n_prims - offset);
+            if (leaves_.occluded((prim_kind)k, offset, count, r, tmin, tmax)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+template class packed_world<4>;
+template class packed_world<8>;
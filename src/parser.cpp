@@ -1,12 +1,15 @@
 #include "parser.hpp"
 
 #include <array>
+#include <iomanip>
+#include <sstream>
 
+#include "instance.hpp"
+#include "mapped_file.hpp"
 #include "tiny_obj_loader.h"
 #include "rectangle.hpp"
 #include "sphere.hpp"
 #include "tracer.hpp"
-#include "triangle.hpp"
 
 std::vector<float> parser::parse_vec(const toml::array &arr, int start, int cnt) {
     std::vector<float> vec(cnt);
@@ -16,28 +19,7 @@ std::vector<float> parser::parse_vec(const toml::array &arr, int start, int cnt)
     return vec;
 }
 
-void parser::transform_mesh(std::vector<point_t> &vertices, transf &trans) {
-    const auto rot = trans.rotate;
-    const auto cosx = std::cos(rot[0]);
-    const auto cosy = std::cos(rot[1]);
-    const auto cosz = std::cos(rot[2]);
-    const auto sinx = std::sin(rot[0]);
-    const auto siny = std::sin(rot[1]);
-    const auto sinz = std::sin(rot[2]);
-    const std::array<vec3_t, 3> rot_mat = {
-        vec3_t{cosy * cosz, sinx * siny * cosz - cosx * sinz, cosx * siny * cosz + sinx * sinz},
-        {cosx * sinz, sinx * siny * sinz + cosx * cosz, cosx * siny * sinz - sinx * cosz},
-        {-siny, sinx * cosy, cosx * cosy}
-    };
-    auto rotate = [&rot_mat](const point_t &vert) {
-        auto res = vert;
-        for (int i = 0; i < 3; i++) {
-            res[i] = rot_mat[i][0] * vert[0] + rot_mat[i][1] * vert[1] + rot_mat[i][2] * vert[2];
-            // res[i] = std::inner_product(vert.begin(), vert.end(), rot_mat.at(i).begin(), 0.0);
-        }
-        return res;
-    };
-
+std::pair<point_t, float> parser::mesh_extent(const std::vector<point_t> &vertices) {
     auto center = std::reduce(std::execution::par, vertices.begin(), vertices.end(),
                               point_t{0.0, 0.0, 0.0}, std::plus<point_t>());
     const auto num_vert = (int)vertices.size();
@@ -51,17 +33,42 @@ void parser::transform_mesh(std::vector<point_t> &vertices, transf &trans) {
                          [&](const point_t &vert1, const point_t vert2) {
                              return distance(vert1, center) < distance(vert2, center);
                          });
-    const auto dist = distance(*farmost, center);
-    trans.scale /= dist;
-    std::for_each(std::execution::par, vertices.begin(), vertices.end(), [&](auto &&vert) {
-        vert = (vert - center) * trans.scale;
-        vert = rotate(vert);
-        vert += trans.translate;
-    });
+    return {center, distance(*farmost, center)};
+}
+
+affine parser::mesh_transform(const std::pair<point_t, float> &extent, const transf &trans) {
+    const auto rot = trans.rotate;
+    const auto cosx = std::cos(rot[0]);
+    const auto cosy = std::cos(rot[1]);
+    const auto cosz = std::cos(rot[2]);
+    const auto sinx = std::sin(rot[0]);
+    const auto siny = std::sin(rot[1]);
+    const auto sinz = std::sin(rot[2]);
+    const std::array<vec3_t, 3> rot_mat = {
+        vec3_t{cosy * cosz, sinx * siny * cosz - cosx * sinz, cosx * siny * cosz + sinx * sinz},
+        {cosx * sinz, sinx * siny * sinz + cosx * cosz, cosx * siny * sinz - sinx * cosz},
+        {-siny, sinx * cosy, cosx * cosy}
+    };
+
+    // 先平移到中心并缩放, 再旋转, 最后平移到指定位置
+    const auto [center, dist] = extent;
+    const auto scale = (float)(trans.scale / dist);
+    std::array<vec3_t, 3> rows;
+    for (int i = 0; i < 3; i++) {
+        rows[i] = rot_mat[i] * scale;
+    }
+    const affine linear{rows, {0, 0, 0}};
+    return {rows, trans.translate - linear.apply_vector(center)};
+}
+
+void parser::transform_mesh(std::vector<point_t> &vertices, const transf &trans) {
+    const auto transform = mesh_transform(mesh_extent(vertices), trans);
+    std::for_each(std::execution::par, vertices.begin(), vertices.end(),
+                  [&](auto &&vert) { vert = transform.apply_point(vert); });
 }
 
 auto parser::read_textures() const -> tex_tbl_t {
-    const auto config = toml::parse_file(scene_path_.string());
+    const auto &config = config_;
     std::cout << "\treading textures...\n";
 
     const auto &textures = *config.get_as<toml::array>("textures");
@@ -87,8 +94,8 @@ auto parser::read_textures() const -> tex_tbl_t {
     return tex_tbl;
 }
 
-auto parser::read_materials(const tex_tbl_t &tex_tbl) const -> mat_tbl_t {
-    const auto config = toml::parse_file(scene_path_.string());
+auto parser::read_materials(const tex_tbl_t &tex_tbl, scene &world) const -> mat_tbl_t {
+    const auto &config = config_;
     std::cout << "\treading materials...\n";
 
     const auto &materials = *config.get_as<toml::array>("materials");
@@ -102,35 +109,40 @@ auto parser::read_materials(const tex_tbl_t &tex_tbl) const -> mat_tbl_t {
         if (mat_type == "lambertian") {
             if (use_tex) {
                 const auto tex_name = mat_info[3].value<std::string>().value();
-                mat_tbl.emplace(mat_name, std::make_shared<lambertian>(tex_tbl.at(tex_name)));
+                mat_tbl.emplace(mat_name,
+                                world.add_material(std::make_unique<lambertian>(tex_tbl.at(tex_name))));
             } else {
                 const auto rgb = parse_vec(mat_info, 3, 3);
-                mat_tbl.emplace(mat_name,
-                                std::make_shared<lambertian>(vec3_t{rgb[0], rgb[1], rgb[2]}));
+                mat_tbl.emplace(mat_name, world.add_material(std::make_unique<lambertian>(
+                                              vec3_t{rgb[0], rgb[1], rgb[2]})));
             }
         } else if (mat_type == "dielectric") {
             if (use_tex) {
             } else {
                 const auto ref_idx = mat_info[3].value<float>().value();
-                mat_tbl.emplace(mat_name, std::make_shared<dielectric>(ref_idx));
+                mat_tbl.emplace(mat_name,
+                                world.add_material(std::make_unique<dielectric>(ref_idx)));
             }
         } else if (mat_type == "metal") {
             if (use_tex) {
                 const auto tex_name = mat_info[3].value<std::string>().value();
                 const auto fuzz = mat_info[4].value<float>().value();
-                mat_tbl.emplace(mat_name, std::make_shared<metal>(tex_tbl.at(tex_name), fuzz));
+                mat_tbl.emplace(mat_name, world.add_material(
+                                              std::make_unique<metal>(tex_tbl.at(tex_name), fuzz)));
             } else {
                 const auto rgbf = parse_vec(mat_info, 3, 4);
-                mat_tbl.emplace(
-                    mat_name, std::make_shared<metal>(vec3_t{rgbf[0], rgbf[1], rgbf[2]}, rgbf[3]));
+                mat_tbl.emplace(mat_name, world.add_material(std::make_unique<metal>(
+                                              vec3_t{rgbf[0], rgbf[1], rgbf[2]}, rgbf[3])));
             }
         } else if (mat_type == "light") {
             if (use_tex) {
                 const auto tex_name = mat_info[3].value<std::string>().value();
-                mat_tbl.emplace(mat_name, std::make_shared<light>(tex_tbl.at(tex_name)));
+                mat_tbl.emplace(mat_name,
+                                world.add_material(std::make_unique<light>(tex_tbl.at(tex_name))));
             } else {
                 const auto rgb = parse_vec(mat_info, 3, 3);
-                mat_tbl.emplace(mat_name, std::make_shared<light>(color_t{rgb[0], rgb[1], rgb[2]}));
+                mat_tbl.emplace(mat_name, world.add_material(std::make_unique<light>(
+                                              color_t{rgb[0], rgb[1], rgb[2]})));
             }
         } else if (mat_type == "pbr") {
             const int info_len = mat_info.size();
@@ -146,7 +158,8 @@ auto parser::read_materials(const tex_tbl_t &tex_tbl) const -> mat_tbl_t {
                 const auto rgb = parse_vec(mat_info, 3, 3);
                 diffuse = std::make_shared<solid_color>(rgb[0], rgb[1], rgb[2]);
             }
-            mat_tbl.emplace(mat_name, std::make_shared<pbr>(diffuse, metalic_tex, roughness_tex));
+            mat_tbl.emplace(mat_name, world.add_material(std::make_unique<pbr>(
+                                          diffuse, metalic_tex, roughness_tex)));
         } else {
             std::cerr << "unknown material: " << mat_type << "\n";
         }
@@ -156,7 +169,7 @@ auto parser::read_materials(const tex_tbl_t &tex_tbl) const -> mat_tbl_t {
 
 void parser::read_objects(const char *name,
                           const std::function<void(const toml::array &info)> &single_parser) const {
-    const auto config = toml::parse_file(scene_path_.string());
+    const auto &config = config_;
     if (!config.contains(name)) {
         return;
     }
@@ -167,24 +180,159 @@ void parser::read_objects(const char *name,
     }
 }
 
-world_t parser::make_scene() const {
+auto parser::read_mesh(const std::filesystem::path &mesh_path, const toml::array &mesh_info,
+                       const mat_tbl_t &mat_tbl, scene &world) -> mesh_data {
+    mesh_data mesh;
+    tinyobj::ObjReader reader;
+    tinyobj::ObjReaderConfig reader_config;
+    reader_config.triangulate = true;
+    if (! reader.ParseFromFile(mesh_path.string(), reader_config)) {
+        if (!reader.Error().empty()) {
+            std::cerr << "TinyObjReader: " << reader.Error();
+        }
+        exit(1);
+    }
+    if (!reader.Warning().empty()) {
+        std::cout << "TinyObjReader: " << reader.Warning();
+    }
+    const auto& attrib = reader.GetAttrib();
+    const auto& shapes = reader.GetShapes();
+    const auto& materials = reader.GetMaterials();
+
+    auto &mesh_materials = mesh.materials;
+    const auto use_tbl_mat = mesh_info[4].value<bool>().value();
+    if (use_tbl_mat) {
+        const auto mat_name = mesh_info[5].value<std::string>().value();
+        mesh_materials.push_back(mat_tbl.at(mat_name));
+    } else {
+        for (auto&& mat : materials) {
+            texture* diffuse_ptr;
+            if (mat.diffuse_texname.size() == 0) {
+                std::cout << "\tno diffuse texture, solid color only\n";
+                const auto color = color_t{mat.diffuse};
+                diffuse_ptr = new solid_color{color};
+            } else {
+                std::cout << "\tdiffuse texture found\n";
+                const auto texpath = mesh_path.parent_path() / mat.diffuse_texname;
+                diffuse_ptr = new image_texture{texpath.string()};
+            }
+            auto diffuse = std::shared_ptr<texture>{diffuse_ptr};
+            
+            texture* metalic_ptr;
+            if (mat.metallic_texname.size() == 0) {
+                std::cout << "\tno metallic texture, solid color only\n";
+                const auto color = color_t{mat.metallic, 0.0, 0.0};
+                metalic_ptr = new solid_color{color};
+            } else {
+                std::cout << "\tmetallic texture found\n";
+                const auto texpath = mesh_path.parent_path() / mat.metallic_texname;
+                metalic_ptr = new image_texture{texpath.string()};
+            }
+            auto metalic = std::shared_ptr<texture>{metalic_ptr};
+
+            texture* roughness_ptr;
+            if (mat.roughness_texname.size() == 0) {
+                std::cout << "\tno roughness texture, solid color only\n";
+                const auto color = color_t{mat.roughness, 0.0, 0.0};
+                roughness_ptr = new solid_color{color};
+            } else {
+                std::cout << "\troughness texture found\n";
+                const auto texpath = mesh_path.parent_path() / mat.roughness_texname;
+                roughness_ptr = new image_texture{texpath.string()};
+            }
+            auto roughness = std::shared_ptr<texture>{roughness_ptr};
+
+            mesh_materials.push_back(
+                world.add_material(std::make_unique<pbr>(diffuse, metalic, roughness)));
+        }
+    }
+
+    auto &vertices = mesh.vertices;
+    auto &tex_coords = mesh.tex_coords;
+    auto &faces = mesh.faces;
+    auto &mat_ids = mesh.mat_ids;
+    // OBJ的面分别引用位置与纹理坐标, 二者下标都相同的顶点才能合并为网格中的同一个顶点
+    std::unordered_map<std::uint64_t, std::uint32_t> vertex_ids;
+    // Loop over shapes
+    for (size_t s = 0; s < shapes.size(); s++) {
+        // Loop over faces(polygon)
+        size_t index_offset = 0;
+        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
+            size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
+            assert(fv == 3); // only triangles are supported
+
+            // Loop over vertices in the face.
+            mesh_data::face_t face{};
+            for (size_t v = 0; v < fv; v++) {
+                // access to vertex
+                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
+                const auto key = ((std::uint64_t)(std::uint32_t)idx.vertex_index << 32) |
+                                 (std::uint32_t)idx.texcoord_index;
+                const auto [found, inserted] =
+                    vertex_ids.try_emplace(key, (std::uint32_t)vertices.size());
+                face[v] = found->second;
+                if (!inserted) {
+                    continue;
+                }
+                tinyobj::real_t vx = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
+                tinyobj::real_t vy = attrib.vertices[3 * size_t(idx.vertex_index) + 1];
+                tinyobj::real_t vz = attrib.vertices[3 * size_t(idx.vertex_index) + 2];
+                vertices.emplace_back(vx, vy, vz);
+
+                // Check if `texcoord_index` is zero or positive. negative = no texcoord data
+                if (idx.texcoord_index >= 0) {
+                    tinyobj::real_t tx = attrib.texcoords[2 * size_t(idx.texcoord_index) + 0];
+                    tinyobj::real_t ty = attrib.texcoords[2 * size_t(idx.texcoord_index) + 1];
+                    tex_coords.push_back(tex_coords_t{tx, ty});
+                } else {
+                    tex_coords.push_back(tex_coords_t{0.0, 0.0});
+                }
+            }
+            index_offset += fv;
+            faces.push_back(face);
+            // per-face material; faces without a material (-1) fall back to the first one
+            if (use_tbl_mat) {
+                mat_ids.push_back(0);
+            } else {
+                mat_ids.push_back((std::uint32_t)std::max(shapes[s].mesh.material_ids[f], 0));
+            }
+        }
+    }
+    return mesh;
+}
+
+triangle_mesh parser::make_mesh(mesh_data mesh) {
+    triangle_mesh result{std::move(mesh.vertices), std::move(mesh.tex_coords),
+                         std::move(mesh.faces), std::move(mesh.mat_ids),
+                         std::move(mesh.materials)};
+    const auto n_faces = std::max<std::size_t>(result.n_faces(), 1);
+    std::cout << "\t" << result.n_faces() << " faces, " << result.positions().size()
+              << " vertices, " << result.memory_size() / 1024 << " KiB ("
+              << result.memory_size() / n_faces << " B/face)\n";
+    return result;
+}
+
+int parser::frame_count() const {
+    const auto &config = config_;
+    return std::max(config["animation"]["frames"].value_or(1), 1);
+}
+
+scene parser::make_scene() const {
     std::cout << "scene reading: started...\n";
 
     std::cout << "\treading textures...\n";
     const auto tex_tbl = read_textures();
 
+    scene world;
     std::cout << "\treading materials...\n";
-    const auto mat_tbl = read_materials(tex_tbl);
-
-    world_t world;
+    const auto mat_tbl = read_materials(tex_tbl, world);
 
     std::cout << "\treading spheres...\n";
     read_objects("spheres", [&](const toml::array &info) {
         const auto xyzr = parse_vec(info, 0, 4);
         const auto mat_name = info[4].value<std::string>().value();
         const auto &sph_mat = mat_tbl.at(mat_name);
-        world.push_back(
-            std::make_shared<sphere>(vec3_t{xyzr[0], xyzr[1], xyzr[2]}, xyzr[3], sph_mat));
+        world.add(sphere{vec3_t{xyzr[0], xyzr[1], xyzr[2]}, xyzr[3], sph_mat});
     });
 
     std::cout << "\treading rectangles...\n";
@@ -196,7 +344,7 @@ world_t parser::make_scene() const {
         }
         const auto mat_name = rect_info[3].value<std::string>().value();
         const auto &rect_mat = mat_tbl.at(mat_name);
-        world.push_back(std::make_shared<rectangle>(points[0], points[1], points[2], rect_mat));
+        world.add(rectangle{points[0], points[1], points[2], rect_mat});
     });
 
     std::cout << "\treading triangles...\n";
@@ -210,11 +358,34 @@ world_t parser::make_scene() const {
         }
         const auto mat_name = tri_info[3].value<std::string>().value();
         const auto &tri_mat = mat_tbl.at(mat_name);
-        world.push_back(
-            std::make_shared<triangle>(vertices[0], vertices[1], vertices[2], tex_coords[0], tex_coords[1], tex_coords[2], tri_mat));
+        // 单独定义的三角形作为只有一个面的网格并入场景的网格
+        world.add(triangle_mesh{{vertices.begin(), vertices.end()},
+                                {tex_coords.begin(), tex_coords.end()},
+                                {{0, 1, 2}},
+                                {0},
+                                {tri_mat}});
     });
 
     std::cout << "\treading meshes...\n";
+    // 开启实例化时, 同一网格文件(及材质设置)只读取一次并构建底层bvh, 每一项成为它的一个实例
+    const auto &config = config_;
+    const bool instancing = config["options"]["mesh_instancing"].value_or(false);
+    const auto bvh_conf = read_bvh_config(config);
+    struct prototype {
+        std::shared_ptr<const bvh> blas;
+        std::pair<point_t, float> extent;
+    };
+    std::unordered_map<std::string, prototype> prototypes;
+    // 动画中第frame帧的网格在初始变换的基础上再平移/旋转frame次; 没有动画时网格读取后即变换到世界空间
+    const bool animated = frame_count() > 1;
+    vec3_t anim_translate;
+    vec3_t anim_rotate;
+    if (const auto *arr = config["animation"]["translate"].as_array()) {
+        anim_translate = vec3_t{parse_vec(*arr, 0, 3).data()};
+    }
+    if (const auto *arr = config["animation"]["rotate"].as_array()) {
+        anim_rotate = vec3_t{parse_vec(*arr, 0, 3).data()};
+    }
     read_objects("meshes", [&](const toml::array &mesh_info) {
         auto mesh_name = mesh_info[0].value<std::string>().value();
         auto mesh_path = scene_path_.parent_path();
@@ -224,144 +395,177 @@ world_t parser::make_scene() const {
         const auto translate = parse_vec(*mesh_info[1].as_array(), 0, 3);
         const auto scale = mesh_info[2].value<double>().value();
         const auto rotate = parse_vec(*mesh_info[3].as_array(), 0, 3);
-        transf transform{(float)scale, vec3_t{translate.data()}, vec3_t{rotate.data()}};
-        for (int i = 0; i < 3; i++) {
-            transform.rotate[i] *= (g_pi / g_pi_in_degree);
-        }
-
-        tinyobj::ObjReader reader;
-        tinyobj::ObjReaderConfig reader_config;
-        reader_config.triangulate = true;
-        if (! reader.ParseFromFile(mesh_path.string(), reader_config)) {
-            if (!reader.Error().empty()) {
-                std::cerr << "TinyObjReader: " << reader.Error();
+        const transf initial{(float)scale, vec3_t{translate.data()}, vec3_t{rotate.data()}};
+        auto frame_transf = [=](int frame) {
+            auto transform = initial;
+            transform.translate += anim_translate * (float)frame;
+            transform.rotate += anim_rotate * (float)frame;
+            for (int i = 0; i < 3; i++) {
+                transform.rotate[i] *= (g_pi / g_pi_in_degree);
             }
-            exit(1);
-        }
-        if (!reader.Warning().empty()) {
-            std::cout << "TinyObjReader: " << reader.Warning();
+            return transform;
+        };
+
+        if (!instancing) {
+            auto mesh = read_mesh(mesh_path, mesh_info, mat_tbl, world);
+            if (!animated) {
+                transform_mesh(mesh.vertices, frame_transf(0));
+                world.add(make_mesh(std::move(mesh)));
+                return;
+            }
+            const auto extent = mesh_extent(mesh.vertices);
+            world.add_animated(make_mesh(std::move(mesh)), [=](int frame) {
+                return mesh_transform(extent, frame_transf(frame));
+            });
+            return;
         }
-        const auto& attrib = reader.GetAttrib();
-        const auto& shapes = reader.GetShapes();
-        const auto& materials = reader.GetMaterials();
-
-        std::vector<std::shared_ptr<material>> mesh_materials;
         const auto use_tbl_mat = mesh_info[4].value<bool>().value();
-        if (use_tbl_mat) {
-            const auto mat_name = mesh_info[5].value<std::string>().value();
-            mesh_materials.push_back(mat_tbl.at(mat_name));
-        } else {
-            for (auto&& mat : materials) {
-                texture* diffuse_ptr;
-                if (mat.diffuse_texname.size() == 0) {
-                    std::cout << "\tno diffuse texture, solid color only\n";
-                    const auto color = color_t{mat.diffuse};
-                    diffuse_ptr = new solid_color{color};
-                } else {
-                    std::cout << "\tdiffuse texture found\n";
-                    const auto texpath = mesh_path.parent_path() / mat.diffuse_texname;
-                    diffuse_ptr = new image_texture{texpath.string()};
-                }
-                auto diffuse = std::shared_ptr<texture>{diffuse_ptr};
-                
-                texture* metalic_ptr;
-                if (mat.metallic_texname.size() == 0) {
-                    std::cout << "\tno metallic texture, solid color only\n";
-                    const auto color = color_t{mat.metallic, 0.0, 0.0};
-                    metalic_ptr = new solid_color{color};
-                } else {
-                    std::cout << "\tmetallic texture found\n";
-                    const auto texpath = mesh_path.parent_path() / mat.metallic_texname;
-                    metalic_ptr = new image_texture{texpath.string()};
-                }
-                auto metalic = std::shared_ptr<texture>{metalic_ptr};
+        const auto material = use_tbl_mat ? mesh_info[5].value<std::string>().value() : "";
+        auto &proto = prototypes[mesh_path.string() + "\n" + material];
+        if (proto.blas == nullptr) {
+            auto mesh = read_mesh(mesh_path, mesh_info, mat_tbl, world);
+            proto.extent = mesh_extent(mesh.vertices);
+            auto blas_world = std::make_shared<world_t>();
+            blas_world->mesh = make_mesh(std::move(mesh));
+            proto.blas = make_blas(std::move(blas_world), mesh_path, material, bvh_conf);
+        }
+        auto object =
+            std::make_shared<instance>(proto.blas, mesh_transform(proto.extent, frame_transf(0)));
+        if (!animated) {
+            world.add(std::move(object));
+            return;
+        }
+        world.add_animated(std::move(object), [=, extent = proto.extent](int frame) {
+            return mesh_transform(extent, frame_transf(frame));
+        });
+    });
 
-                texture* roughness_ptr;
-                if (mat.roughness_texname.size() == 0) {
-                    std::cout << "\tno roughness texture, solid color only\n";
-                    const auto color = color_t{mat.roughness, 0.0, 0.0};
-                    roughness_ptr = new solid_color{color};
-                } else {
-                    std::cout << "\troughness texture found\n";
-                    const auto texpath = mesh_path.parent_path() / mat.roughness_texname;
-                    roughness_ptr = new image_texture{texpath.string()};
-                }
-                auto roughness = std::shared_ptr<texture>{roughness_ptr};
+    std::cout << "scene reading: done.\n\n";
 
-                mesh_materials.push_back(std::make_shared<pbr>(diffuse, metalic, roughness));
-            }
-        }
+    return world;
+}
 
-        // TODO: directly transform attrib.vertices and create triangles while looping
-        std::vector<point_t> vertices;
-        std::vector<tex_coords_t> tex_coords;
-        using face_t = std::array<int, 3>;
-        std::vector<face_t> faces;
-        std::vector<int> mat_idx;
-        // Loop over shapes
-        for (size_t s = 0; s < shapes.size(); s++) {
-            // Loop over faces(polygon)
-            size_t index_offset = 0;
-            for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-                size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
-                assert(fv == 3); // only triangles are supported
-
-                // Loop over vertices in the face.
-                for (size_t v = 0; v < fv; v++) {
-                    // access to vertex
-                    tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                    tinyobj::real_t vx = attrib.vertices[3 * size_t(idx.vertex_index) + 0];
-                    tinyobj::real_t vy = attrib.vertices[3 * size_t(idx.vertex_index) + 1];
-                    tinyobj::real_t vz = attrib.vertices[3 * size_t(idx.vertex_index) + 2];
-                    vertices.emplace_back(vx, vy, vz);
-
-                    // Check if `texcoord_index` is zero or positive. negative = no texcoord data
-                    if (idx.texcoord_index >= 0) {
-                        tinyobj::real_t tx = attrib.texcoords[2 * size_t(idx.texcoord_index) + 0];
-                        tinyobj::real_t ty = attrib.texcoords[2 * size_t(idx.texcoord_index) + 1];
-                        tex_coords.push_back(tex_coords_t{tx, ty});
-                    } else {
-                        tex_coords.push_back(tex_coords_t{0.0, 0.0});
-                    }
-                }
-                index_offset += fv;
-                const int nvert = (int)vertices.size();
-                faces.push_back(face_t{nvert - 3, nvert - 2, nvert - 1});
-                // per-face material
-                if (use_tbl_mat) {
-                    mat_idx.push_back(0);
-                } else {
-                    mat_idx.push_back(shapes[s].mesh.material_ids[f]);
-                }
-            }
+std::uint64_t parser::geometry_hash() const {
+    const auto &config = config_;
+    std::uint64_t hash = fnv1a(nullptr, 0);
+    for (const char *name : {"spheres", "rectangles", "triangles", "meshes"}) {
+        if (!config.contains(name)) {
+            continue;
         }
-        transform_mesh(vertices, transform);
-        const int nface = (int)faces.size();
-        for (int i = 0; i < nface; i++) {
-            const auto [v0, v1, v2] = faces[i];
-            const int matidx = mat_idx[i];  // TODO: can be -1 when no material is assigned
-            world.push_back(std::make_shared<triangle>(
-                vertices[v0], vertices[v1], vertices[v2],
-                tex_coords[v0], tex_coords[v1], tex_coords[v2], mesh_materials[matidx])
-            );
+        std::ostringstream text;
+        text << name << *config.get_as<toml::array>(name);
+        const auto str = text.str();
+        hash = fnv1a(str.data(), str.size(), hash);
+    }
+    // 动画的帧数与每帧的变换同样参与计算, 只有动画不同的两个场景不会共用缓存
+    if (const auto *animation = config["animation"].as_table()) {
+        std::ostringstream text;
+        text << "animation" << *animation;
+        const auto str = text.str();
+        hash = fnv1a(str.data(), str.size(), hash);
+    }
+    // 是否开启实例化决定了顶层bvh的图元是三角形还是实例
+    const bool instancing = config["options"]["mesh_instancing"].value_or(false);
+    hash = fnv1a(&instancing, sizeof(instancing), hash);
+    // 网格由文件名引用, 还需要计算文件本身的内容
+    read_objects("meshes", [&](const toml::array &mesh_info) {
+        const auto mesh_name = mesh_info[0].value<std::string>().value();
+        const mapped_file file{scene_path_.parent_path() / mesh_name};
+        if (file.is_open()) {
+            hash = fnv1a(file.data(), file.size(), hash);
         }
     });
+    return hash;
+}
 
-    std::cout << "scene reading: done.\n\n";
+std::filesystem::path parser::bvh_cache_path(const std::string &cache_dir,
+                                             std::uint64_t key) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".bvh";
+    return scene_path_.parent_path() / cache_dir / name.str();
+}
 
-    return world;
+std::shared_ptr<const bvh> parser::make_blas(std::shared_ptr<world_t> mesh_world,
+                                             const std::filesystem::path &mesh_path,
+                                             const std::string &material,
+                                             const bvh::config &bvh_conf) const {
+    const auto cache_dir = config_["options"]["bvh_cache"].value<std::string>();
+    if (!cache_dir.has_value()) {
+        return std::make_shared<const bvh>(std::move(mesh_world), bvh_conf);
+    }
+    const mapped_file file{mesh_path};
+    auto hash = file.is_open() ? fnv1a(file.data(), file.size()) : fnv1a(nullptr, 0);
+    hash = fnv1a(material.data(), material.size(), hash);
+    const auto key = bvh::cache_key(bvh_conf, hash);
+    const auto path = bvh_cache_path(cache_dir.value(), key);
+    auto cached = bvh::load(path, key, mesh_world, bvh_conf);
+    if (cached.has_value()) {
+        std::cout << "\tloaded mesh BVH from cache " << path.string() << "\n";
+        return std::make_shared<const bvh>(std::move(cached.value()));
+    }
+    auto blas = std::make_shared<const bvh>(std::move(mesh_world), bvh_conf);
+    if (blas->save(path, key)) {
+        std::cout << "\tsaved mesh BVH to cache " << path.string() << "\n";
+    } else {
+        std::cerr << "failed to write bvh cache " << path.string() << "\n";
+    }
+    return blas;
+}
+
+bvh::config parser::read_bvh_config(const toml::table &config) {
+    bvh::config bvh_conf;
+    bvh_conf.bins = config["options"]["bvh_bins"].value_or(bvh_conf.bins);
+    bvh_conf.max_leaf_size =
+        config["options"]["bvh_max_leaf_size"].value_or(bvh_conf.max_leaf_size);
+    bvh_conf.cost_ratio = config["options"]["bvh_cost_ratio"].value_or(bvh_conf.cost_ratio);
+    const auto bvh_builder = config["options"]["bvh_builder"].value_or<std::string>("sah");
+    if (bvh_builder == "sbvh") {
+        bvh_conf.builder = bvh::builder_type::spatial;
+    } else if (bvh_builder == "lbvh") {
+        bvh_conf.builder = bvh::builder_type::linear;
+    } else if (bvh_builder != "sah") {
+        std::cerr << "unsupported bvh builder: " << bvh_builder << ", using sah\n";
+    }
+    bvh_conf.split_budget =
+        config["options"]["bvh_split_budget"].value_or(bvh_conf.split_budget);
+    bvh_conf.lbvh_sah_top = config["options"]["bvh_lbvh_sah_top"].value_or(bvh_conf.lbvh_sah_top);
+    bvh_conf.rebuild_threshold =
+        config["options"]["bvh_rebuild_threshold"].value_or(bvh_conf.rebuild_threshold);
+    bvh_conf.treelet_passes =
+        config["options"]["bvh_treelet_passes"].value_or(bvh_conf.treelet_passes);
+    return bvh_conf;
 }
 
 tracer parser::make_tracer() const {
     std::cout << "tracer configuring: started...\n";
-    const auto config = toml::parse_file(scene_path_.string());
+    const auto &config = config_;
     const int width = config["canvas"]["width"].value<int>().value();
     const int height = config["canvas"]["height"].value<int>().value();
     const int samples_per_pixel = config["options"]["samples_per_pixel"].value<int>().value();
     const int max_depth = config["options"]["max_depth"].value<int>().value();
     const bool use_bvh = config["options"]["use_bvh"].value<bool>().value();
     const bool parallel = config["options"]["parallel"].value<bool>().value();
-    tracer::config tconfig{width, height, samples_per_pixel, max_depth, use_bvh, parallel};
+    const auto bvh_conf = read_bvh_config(config);
+    int bvh_width = config["options"]["bvh_width"].value_or(2);
+    if (bvh_width != 2 && bvh_width != 4 && bvh_width != 8) {
+        std::cerr << "unsupported bvh width: " << bvh_width << ", using binary bvh\n";
+        bvh_width = 2;
+    }
+    tracer::config tconfig{width,    height,   samples_per_pixel, max_depth, use_bvh,
+                           parallel, bvh_conf, bvh_width};
+    tconfig.bvh_quantized = config["options"]["bvh_quantized"].value_or(false);
+    tconfig.bvh_report = config["options"]["bvh_report"].value_or(false);
+    tconfig.frames = frame_count();
+    const auto bvh_report_json = config["options"]["bvh_report_json"].value<std::string>();
+    if (bvh_report_json.has_value()) {
+        tconfig.bvh_report = true;
+        tconfig.bvh_report_json = (scene_path_.parent_path() / bvh_report_json.value()).string();
+    }
+    const auto bvh_cache = config["options"]["bvh_cache"].value<std::string>();
+    if (use_bvh && bvh_cache.has_value()) {
+        tconfig.bvh_key = bvh::cache_key(bvh_conf, geometry_hash());
+        tconfig.bvh_cache = bvh_cache_path(bvh_cache.value(), tconfig.bvh_key).string();
+    }
 
     const float aspect_ratio = (float)width / (float)height;
 
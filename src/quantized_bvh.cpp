@@ -0,0 +1,182 @@
+#include "quantized_bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr int quant_steps = 255;
+
+/**
+ * @brief 由父包围盒与量化值解码子包围盒; 编码与遍历使用同一个函数, 保证结果完全一致
+ */
+aabb decode(const aabb &parent, const std::array<std::uint8_t, 6> &quant) {
+    const auto &plow = parent.low();
+    const auto &phigh = parent.high();
+    point_t low;
+    point_t high;
+    for (int axis = 0; axis < 3; axis++) {
+        const float step = (phigh[axis] - plow[axis]) * (1.0F / quant_steps);
+        low[axis] = plow[axis] + (float)quant[axis] * step;
+        high[axis] = phigh[axis] - (float)quant[axis + 3] * step;
+    }
+    return {low, high};
+}
+
+/**
+ * @brief 把box量化为相对于parent的8位整数, 解码后的包围盒总是包含box
+ */
+std::array<std::uint8_t, 6> encode(const aabb &parent, const aabb &box) {
+    const auto &plow = parent.low();
+    const auto &phigh = parent.high();
+    std::array<std::uint8_t, 6> quant{};
+    for (int axis = 0; axis < 3; axis++) {
+        const float extent = phigh[axis] - plow[axis];
+        if (!(extent > 0)) {
+            continue;
+        }
+        const float scale = quant_steps / extent;
+        auto low_steps = (int)std::floor((box.low()[axis] - plow[axis]) * scale);
+        auto high_steps = (int)std::floor((phigh[axis] - box.high()[axis]) * scale);
+        quant[axis] = (std::uint8_t)std::clamp(low_steps, 0, quant_steps);
+        quant[axis + 3] = (std::uint8_t)std::clamp(high_steps, 0, quant_steps);
+        // 估计值可能因为浮点误差多出一份, 逐步回退直到解码结果确实包含box
+        while (quant[axis] > 0 && decode(parent, quant).low()[axis] > box.low()[axis]) {
+            quant[axis]--;
+        }
+        while (quant[axis + 3] > 0 && decode(parent, quant).high()[axis] < box.high()[axis]) {
+            quant[axis + 3]--;
+        }
+    }
+    return quant;
+}
+}  // namespace
+
+quantized_bvh::quantized_bvh(const bvh &binary) : leaves_(binary.leaves<4>()) {
+    const auto &binary_nodes = binary.nodes();
+    if (binary_nodes.empty()) {
+        return;
+    }
+    const auto &root = binary_nodes.front();
+    bounds_ = root.bounding;
+    if (root.is_leaf()) {
+        root_offset_ = root.offset;
+        root_count_ = (std::uint8_t)root.count;
+        root_kind_ = root.kind;
+        return;
+    }
+    nodes_.reserve(binary_nodes.size() / 2);
+    compress(binary_nodes, 0, bounds_);
+}
+
+std::uint32_t quantized_bvh::compress(const std::vector<bvh_node> &binary, std::uint32_t index,
+                                      const aabb &decoded) {
+    const auto result = (std::uint32_t)nodes_.size();
+    nodes_.emplace_back();
+    const std::array<std::uint32_t, 2> slots = {index + 1, binary[index].offset};
+    std::array<aabb, 2> child_boxes;
+    for (int i = 0; i < 2; i++) {
+        auto &node = nodes_[result];
+        const auto &child = binary[slots[i]];
+        node.boxes[i] = encode(decoded, child.bounding);
+        node.children[i] = child.offset;
+        node.counts[i] = (std::uint8_t)child.count;
+        node.kinds |= (std::uint8_t)((std::uint8_t)child.kind << (4 * i));
+        child_boxes[i] = decode(decoded, node.boxes[i]);
+    }
+    nodes_[result].axis = binary[index].axis;
+    // 子节点以解码后的包围盒为基准继续量化, 遍历时的误差因此不会逐层累积
+    for (int i = 0; i < 2; i++) {
+        if (!binary[slots[i]].is_leaf()) {
+            const auto target = compress(binary, slots[i], child_boxes[i]);
+            nodes_[result].children[i] = target;
+        }
+    }
+    return result;
+}
+
+isect_res_t quantized_bvh::intersect(const ray &r, float tmin, float tmax) const {
+    if (root_count_ == 0 && nodes_.empty()) {
+        return std::nullopt;
+    }
+    const auto root_entry = bounds_.entry(r, tmin, tmax);
+    if (!root_entry.has_value()) {
+        return std::nullopt;
+    }
+    const auto &dir_neg = r.dir_neg();
+
+    // 栈中除了节点下标, 还要保存解码后的包围盒, 作为解码其子节点的基准
+    struct entry {
+        aabb box;
+        std::uint32_t index;
+        std::uint8_t count;  // 大于0时表示叶子
+        prim_kind kind;
+        float tnear;
+    };
+    std::array<entry, bvh::max_depth + 1> stack{};
+    int top = 0;
+    stack[top++] = {bounds_, root_count_ > 0 ? root_offset_ : 0, root_count_, root_kind_,
+                    root_entry.value()};
+
+    const auto &leaves = leaves_;
+    isect_res_t res = std::nullopt;
+    while (top > 0) {
+        const auto current = stack[--top];
+        if (current.tnear >= tmax) {
+            continue;
+        }
+        if (current.count > 0) {
+            const auto isect =
+                leaves.intersect(current.kind, current.index, current.count, r, tmin, tmax);
+            if (isect.has_value()) {
+                tmax = isect->ray_param;
+                res = isect;
+            }
+            continue;
+        }
+        // 与二叉bvh相同, 按划分轴上的光线方向决定先访问哪个子节点; 近端后入栈先访问
+        const auto &node = nodes_[current.index];
+        const int near = dir_neg[node.axis] ? 1 : 0;
+        for (const int child : {1 - near, near}) {
+            const auto box = decode(current.box, node.boxes[child]);
+            const auto child_entry = box.entry(r, tmin, tmax);
+            if (child_entry.has_value()) {
+                stack[top++] = {box, node.children[child], node.counts[child], node.kind(child),
+                                child_entry.value()};
+            }
+        }
+    }
+    return res;
+}
+
+bool quantized_bvh::occluded(const ray &r, float tmin, float tmax) const {
+    if ((root_count_ == 0 && nodes_.empty()) || !bounds_.hit(r, tmin, tmax)) {
+        return false;
+    }
+    struct entry {
+        aabb box;
+        std::uint32_t index;
+        std::uint8_t count;
+        prim_kind kind;
+    };
+    std::array<entry, bvh::max_depth + 1> stack{};
+    int top = 0;
+    stack[top++] = {bounds_, root_count_ > 0 ? root_offset_ : 0, root_count_, root_kind_};
+    const auto &leaves = leaves_;
+    while (top > 0) {
+        const auto current = stack[--top];
+        if (current.count > 0) {
+            if (leaves.occluded(current.kind, current.index, current.count, r, tmin, tmax)) {
+                return true;
+            }
+            continue;
+        }
+        const auto &node = nodes_[current.index];
+        for (int child = 0; child < 2; child++) {
+            const auto box = decode(current.box, node.boxes[child]);
+            if (box.hit(r, tmin, tmax)) {
+                stack[top++] = {box, node.children[child], node.counts[child], node.kind(child)};
+            }
+        }
+    }
+    return false;
+}
@@ -5,30 +5,49 @@
 #include "aabb.hpp"
 #include "ray.hpp"
 
-hit_res_t rectangle::hit(const ray &r, float tmin, float tmax) const {
-    const float divisor = normal_.dot(r.direction());
+std::optional<float> intersect_rectangle(const ray &r, const point_t &corner,
+                                         const vec3_t &edge_u, const vec3_t &edge_v,
+                                         const unit_vec3 &normal, float tmin, float tmax,
+                                         tex_coords_t &tex_coords) {
+    const float divisor = normal.dot(r.direction());
     if (divisor == 0) {
         return std::nullopt;
     }
-    const float t = normal_.dot(corner_ - r.origin()) / divisor;
+    const float t = normal.dot(corner - r.origin()) / divisor;
     if (t < tmin || t > tmax) {
         return std::nullopt;
     }
     const point_t point = r.point_at(t);
-    const float tex_u = (point - corner_).dot(edge_u_) / edge_u_.len_sq();
+    const float tex_u = (point - corner).dot(edge_u) / edge_u.len_sq();
     if (tex_u < 0 || tex_u > 1) {
         return std::nullopt;
     }
-    const float tex_v = (point - corner_).dot(edge_v_) / edge_v_.len_sq();
+    const float tex_v = (point - corner).dot(edge_v) / edge_v.len_sq();
     if (tex_v < 0 || tex_v > 1) {
         return std::nullopt;
     }
+    tex_coords = {tex_u, tex_v};
+    return t;
+}
+
+isect_res_t rectangle::intersect(const ray &r, float tmin, float tmax) const {
+    tex_coords_t tex_coords;
+    const auto t =
+        intersect_rectangle(r, corner_, edge_u_, edge_v_, normal_, tmin, tmax, tex_coords);
+    if (!t.has_value()) {
+        return std::nullopt;
+    }
+    return intersection{t.value(), tex_coords, 0, this};
+}
+
+hit_record rectangle::surface_interaction(const ray &r, const intersection &isect) const {
+    const float divisor = normal_.dot(r.direction());
     hit_record record;
-    record.ray_param = t;
-    record.point = point;
+    record.ray_param = isect.ray_param;
+    record.point = r.point_at(isect.ray_param);
     record.outside = divisor < 0;
     record.normal = divisor < 0 ? normal_ : -normal_;
-    record.tex_coords = {tex_u, tex_v};
+    record.tex_coords = isect.uv;
     record.pmat = pmat_;
     return record;
 }
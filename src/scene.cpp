@@ -0,0 +1,26 @@
+#include "scene.hpp"
+
+#include "instance.hpp"
+#include "triangle_mesh.hpp"
+
+void scene::add_animated(const triangle_mesh &mesh, transform_fn transform) {
+    const auto first_vertex = (std::uint32_t)world_->mesh.positions().size();
+    world_->mesh.append(mesh);
+    meshes_.push_back({first_vertex, mesh.positions(), std::move(transform)});
+}
+
+void scene::add_animated(std::shared_ptr<instance> object, transform_fn transform) {
+    world_->objects.push_back(object);
+    instances_.push_back({std::move(object), std::move(transform)});
+}
+
+std::shared_ptr<world_t> scene::frame(int frame) {
+    // bvh重排的是各面的顺序, 顶点的位置不变, first_vertex始终有效
+    for (auto &&anim : meshes_) {
+        world_->mesh.transform(anim.first_vertex, anim.positions, anim.transform(frame));
+    }
+    for (auto &&anim : instances_) {
+        anim.object->set_transform(anim.transform(frame));
+    }
+    return world_;
+}
@@ -8,10 +8,11 @@ tex_coords_t sphere::uv_at(const point_t &point) const {
     return {phi / (2.0F * g_pi), theta / g_pi};
 }
 
-hit_res_t sphere::hit(const ray &r, float tmin, float tmax) const {
-    const vec3_t oc = r.origin() - center_;
+std::optional<float> intersect_sphere(const ray &r, const point_t &center, float radius,
+                                      float tmin, float tmax) {
+    const vec3_t oc = r.origin() - center;
     const float b_half = oc.dot(r.direction());
-    const float c = oc.len_sq() - radius_ * radius_;
+    const float c = oc.len_sq() - radius * radius;
     const float discriminant = b_half * b_half - c;
     if (discriminant < 0) {
         return std::nullopt;
@@ -25,9 +26,20 @@ hit_res_t sphere::hit(const ray &r, float tmin, float tmax) const {
             return std::nullopt;
         }
     }
+    return root;
+}
+
+isect_res_t sphere::intersect(const ray &r, float tmin, float tmax) const {
+    const auto root = intersect_sphere(r, center_, radius_, tmin, tmax);
+    if (!root.has_value()) {
+        return std::nullopt;
+    }
+    return intersection{root.value(), {}, 0, this};
+}
 
+hit_record sphere::surface_interaction(const ray &r, const intersection &isect) const {
     hit_record record;
-    record.ray_param = root;
+    record.ray_param = isect.ray_param;
     record.point = r.point_at(record.ray_param);
     record.normal = unit_vec3(record.point - center_);
     record.outside = (r.direction().dot(record.normal) < 0) == (radius_ > 0);
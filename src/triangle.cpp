@@ -5,48 +5,66 @@
 #include "aabb.hpp"
 #include "ray.hpp"
 
-hit_res_t triangle::hit(const ray &r, float tmin, float tmax) const {
-    const float divisor = normal_.dot(r.direction());
-    if (divisor == 0) {
+std::optional<float> intersect_triangle(const ray &r, const point_t &vertex0, const vec3_t &edge1,
+                                        const vec3_t &edge2, float tmin, float tmax,
+                                        std::array<float, 3> &bary) {
+    const auto direction = r.direction();
+    const vec3_t pvec = direction.cross(edge2);
+    const float det = edge1.dot(pvec);
+    if (det == 0) {
+        return std::nullopt;  // 光线与三角形平行
+    }
+    const float inv_det = 1.0F / det;
+    const vec3_t tvec = r.origin() - vertex0;
+    const float u = tvec.dot(pvec) * inv_det;
+    // 有序比较, 出现NaN时视为不相交, 与三角形块的SIMD求交保持一致
+    if (!(u >= 0 && u <= 1)) {
         return std::nullopt;
     }
-    const float t = -(normal_.dot(r.origin()) + dist_to_origin_) / divisor;
-    if (t < tmin || t > tmax) {
+    const vec3_t qvec = tvec.cross(edge1);
+    const float v = direction.dot(qvec) * inv_det;
+    if (!(v >= 0 && u + v <= 1)) {
         return std::nullopt;
     }
+    const float t = edge2.dot(qvec) * inv_det;
+    if (!(t >= tmin && t <= tmax)) {
+        return std::nullopt;
+    }
+    bary = {1 - u - v, u, v};
+    return t;
+}
 
-    const point_t point = r.point_at(t);
+isect_res_t triangle::intersect(const ray &r, float tmin, float tmax) const {
     std::array<float, 3> bary{};
-    for (int i = 0; i < 3; i++) {
-        bary.at(i) = edges_.at(i).cross(point - vertex(i + 1)).len() / area2_;
-        if (bary.at(i) < 0 || bary.at(i) > 1) {
-            return std::nullopt;
-        }
-    }
-    const float diff = std::abs(bary[0] + bary[1] + bary[2] - 1);
-    if (diff > std::numeric_limits<float>::epsilon()) {
+    const auto t = intersect_triangle(r, vertices_[0], edge1_, edge2_, tmin, tmax, bary);
+    if (!t.has_value()) {
         return std::nullopt;
     }
+    return intersection{t.value(), {bary[1], bary[2]}, 0, this};
+}
 
+hit_record triangle::surface_interaction(const ray &r, const intersection &isect) const {
+    const std::array<float, 3> bary = {1 - isect.uv[0] - isect.uv[1], isect.uv[0], isect.uv[1]};
+    const float divisor = normal_.dot(r.direction());
     hit_record rec;
-    rec.ray_param = t;
-    rec.point = point;
+    rec.ray_param = isect.ray_param;
+    rec.point = r.point_at(isect.ray_param);
     rec.outside = divisor < 0;
     rec.normal = divisor < 0 ? normal_ : -normal_;
     rec.pmat = pmat_;
     rec.tex_coords = {0, 0};
     for (int i = 0; i < 3; i++) {
-        rec.tex_coords.at(0) += bary.at(i) * tex_coords_.at(i).at(0);
-        rec.tex_coords.at(1) += bary.at(i) * tex_coords_.at(i).at(1);
+        rec.tex_coords[0] += bary[i] * tex_coords_[i][0];
+        rec.tex_coords[1] += bary[i] * tex_coords_[i][1];
     }
     return rec;
 }
 
-aabb triangle::bounding_box() const {
+aabb triangle_bounds(const std::array<point_t, 3> &vertices) {
     const auto g_max = std::numeric_limits<float>::max();
     std::array<float, 3> coord_min = {g_max, g_max, g_max};
     std::array<float, 3> coord_max = {-g_max, -g_max, -g_max};
-    for (auto &&vertex : vertices_) {
+    for (auto &&vertex : vertices) {
         for (int k = 0; k < 3; k++) {  // x,y,z维度
             coord_min.at(k) = std::min(coord_min.at(k), vertex[k]);
             coord_max.at(k) = std::max(coord_max.at(k), vertex[k]);
@@ -57,4 +75,44 @@ aabb triangle::bounding_box() const {
         coord_max.at(k) += aabb::dim_padding;
     }
     return aabb{vec3_t{coord_min.data()}, vec3_t{coord_max.data()}};
-}
\ No newline at end of file
+}
+
+aabb clipped_triangle_bounds(const std::array<point_t, 3> &vertices, int axis, float low,
+                             float high) {
+    // Sutherland-Hodgman算法: 依次保留low平面之上与high平面之下的部分,
+    // 每次裁剪至多使顶点数翻倍(数值误差下多边形可能不再是凸的)
+    std::array<point_t, 12> polygon{vertices[0], vertices[1], vertices[2]};
+    int n_vertices = 3;
+    auto clip = [&](float plane, float sign) {
+        const auto input = polygon;
+        const int n_input = n_vertices;
+        n_vertices = 0;
+        for (int i = 0; i < n_input; i++) {
+            const auto &current = input.at(i);
+            const auto &next = input.at((i + 1) % n_input);
+            const float dist_current = sign * (current[axis] - plane);
+            const float dist_next = sign * (next[axis] - plane);
+            if (dist_current >= 0) {
+                polygon.at(n_vertices++) = current;
+            }
+            if ((dist_current >= 0) != (dist_next >= 0)) {
+                const float ratio = dist_current / (dist_current - dist_next);
+                auto point = current + (next - current) * ratio;
+                point[axis] = plane;
+                polygon.at(n_vertices++) = point;
+            }
+        }
+    };
+    clip(low, 1);
+    clip(high, -1);
+    if (n_vertices == 0) {
+        return aabb{};
+    }
+
+    aabb bounds;
+    for (int i = 0; i < n_vertices; i++) {
+        bounds = bounds.union_with({polygon.at(i), polygon.at(i)});
+    }
+    const vec3_t padding{aabb::dim_padding, aabb::dim_padding, aabb::dim_padding};
+    return {bounds.low() - padding, bounds.high() + padding};
+}
@@ -0,0 +1,112 @@
+#include "triangle_mesh.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <execution>
+
+#include "affine.hpp"
+#include "ray.hpp"
+#include "triangle.hpp"
+
+triangle_mesh::triangle_mesh(std::vector<point_t> positions,
+                             std::vector<tex_coords_t> tex_coords, std::vector<face_t> faces,
+                             std::vector<std::uint32_t> mat_ids,
+                             std::vector<const material *> materials)
+    : positions_(std::move(positions)),
+      tex_coords_(std::move(tex_coords)),
+      faces_(std::move(faces)),
+      mat_ids_(std::move(mat_ids)),
+      materials_(std::move(materials)) {
+    assert(tex_coords_.size() == positions_.size());
+    assert(mat_ids_.size() == faces_.size());
+}
+
+void triangle_mesh::append(const triangle_mesh &other) {
+    const auto first_vertex = (std::uint32_t)positions_.size();
+    const auto first_material = (std::uint32_t)materials_.size();
+    positions_.insert(positions_.end(), other.positions_.begin(), other.positions_.end());
+    tex_coords_.insert(tex_coords_.end(), other.tex_coords_.begin(), other.tex_coords_.end());
+    materials_.insert(materials_.end(), other.materials_.begin(), other.materials_.end());
+    faces_.reserve(faces_.size() + other.faces_.size());
+    for (const auto &face : other.faces_) {
+        faces_.push_back({face[0] + first_vertex, face[1] + first_vertex, face[2] + first_vertex});
+    }
+    mat_ids_.reserve(mat_ids_.size() + other.mat_ids_.size());
+    for (const auto mat_id : other.mat_ids_) {
+        mat_ids_.push_back(mat_id + first_material);
+    }
+}
+
+void triangle_mesh::reorder_faces(const std::vector<std::uint32_t> &order) {
+    std::vector<face_t> faces(order.size());
+    std::vector<std::uint32_t> mat_ids(order.size());
+    for (std::size_t i = 0; i < order.size(); i++) {
+        faces[i] = faces_[order[i]];
+        mat_ids[i] = mat_ids_[order[i]];
+    }
+    faces_ = std::move(faces);
+    mat_ids_ = std::move(mat_ids);
+}
+
+isect_res_t triangle_mesh::intersect(const ray &r, float tmin, float tmax) const {
+    isect_res_t res = std::nullopt;
+    for (std::uint32_t f = 0; f < faces_.size(); f++) {
+        const auto points = vertices(f);
+        std::array<float, 3> bary{};
+        const auto t = intersect_triangle(r, points[0], points[1] - points[0],
+                                          points[2] - points[0], tmin, tmax, bary);
+        if (t.has_value()) {
+            tmax = t.value();
+            res = intersection{tmax, {bary[1], bary[2]}, f, this};
+        }
+    }
+    return res;
+}
+
+hit_record triangle_mesh::surface_interaction(const ray &r, const intersection &isect) const {
+    // 法向只在构造交点信息时计算, 与triangle相同, 取顶点按右手方向旋转得到的方向
+    const std::array<float, 3> bary = {1 - isect.uv[0] - isect.uv[1], isect.uv[0], isect.uv[1]};
+    const float t = isect.ray_param;
+    const auto points = vertices(isect.face);
+    const unit_vec3 normal = (points[1] - points[0]).cross(points[2] - points[0]).normalized();
+    const float divisor = normal.dot(r.direction());
+    hit_record rec;
+    rec.ray_param = t;
+    rec.point = r.point_at(t);
+    rec.outside = divisor < 0;
+    rec.normal = divisor < 0 ? normal : -normal;
+    rec.pmat = material_of(isect.face);
+    rec.tex_coords = {0, 0};
+    const auto &indices = faces_[isect.face];
+    for (int i = 0; i < 3; i++) {
+        const auto &tex_coords = tex_coords_[indices[i]];
+        rec.tex_coords[0] += bary[i] * tex_coords[0];
+        rec.tex_coords[1] += bary[i] * tex_coords[1];
+    }
+    return rec;
+}
+
+aabb triangle_mesh::bounding_box() const {
+    aabb bounding;
+    for (std::uint32_t f = 0; f < faces_.size(); f++) {
+        bounding = bounding.union_with(face_bounds(f));
+    }
+    return bounding;
+}
+
+aabb triangle_mesh::face_bounds(std::uint32_t face) const {
+    return triangle_bounds(vertices(face));
+}
+
+aabb triangle_mesh::clipped_face_bounds(std::uint32_t face, int axis, float low,
+                                        float high) const {
+    return clipped_triangle_bounds(vertices(face), axis, low, high);
+}
+
+void triangle_mesh::transform(std::uint32_t first_vertex, const std::vector<point_t> &positions,
+                              const affine &to_world) {
+    assert(first_vertex + positions.size() <= positions_.size());
+    std::transform(std::execution::par, positions.begin(), positions.end(),
+                   positions_.begin() + first_vertex,
+                   [&](const point_t &position) { return to_world.apply_point(position); });
+}
@@ -1,11 +1,17 @@
 #include "utils.hpp"
 
+#include <array>
 #include <ctime>
 #include <iomanip>
 #include <optional>
 #include <random>
 #include <sstream>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
 float random_float(float lower, float upper) {
     std::uniform_real_distribution<float> dist(lower, upper);
     static std::random_device rd;
@@ -65,6 +71,38 @@ std::string current_time() {
     return ss.str();
 }
 
+std::uint64_t fnv1a(const void *data, std::size_t size, std::uint64_t hash) {
+    constexpr std::uint64_t prime = 1099511628211ULL;
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    for (std::size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+    return hash;
+}
+
+bool cpu_supports_avx2() {
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    // 同时检查了操作系统是否保存AVX寄存器的状态
+    return __builtin_cpu_supports("avx2") != 0;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    std::array<int, 4> info{};
+    __cpuid(info.data(), 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info.data(), 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info.data(), 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
 float srgb_to_linear(float srgb) {
     return srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4);
 }
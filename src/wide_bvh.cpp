@@ -0,0 +1,339 @@
+#include "wide_bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "simd.hpp"
+
+namespace {
+/**
+ * @brief 光线与节点的全部子包围盒求交. 通用的标量实现, 用于没有相应SIMD指令集的平台
+ */
+template <int Width>
+struct slab_kernel {
+    std::array<float, 3> origin;
+    std::array<float, 3> inv_dir;
+
+    explicit slab_kernel(const ray &r) {
+        const auto &org = r.origin();
+        const auto &direction_inv = r.inv_direction();
+        for (int i = 0; i < 3; i++) {
+            origin[i] = org[i];
+            inv_dir[i] = direction_inv[i];
+        }
+    }
+
+    /**
+     * @param tnear 输出每个子包围盒的入射参数
+     * @return 第i位表示光线在(tmin, tmax)内与第i个子包围盒相交
+     */
+    int operator()(const wide_bvh_node<Width> &node, float tmin, float tmax,
+                   std::array<float, Width> &tnear) const {
+        int mask = 0;
+        for (int child = 0; child < Width; child++) {
+            float near = tmin;
+            float far = tmax;
+            for (int axis = 0; axis < 3; axis++) {
+                const float t0 = (node.low[axis][child] - origin[axis]) * inv_dir[axis];
+                const float t1 = (node.high[axis][child] - origin[axis]) * inv_dir[axis];
+                // 原点位于包围盒的某个面上且方向分量为0时参数是0*inf=NaN, 与aabb::entry一样
+                // 这一轴不限制参数区间
+                if (std::isnan(t0) || std::isnan(t1)) {
+                    continue;
+                }
+                near = std::max(near, std::min(t0, t1));
+                far = std::min(far, std::max(t0, t1));
+            }
+            tnear[child] = near;
+            mask |= (near < far ? 1 : 0) << child;
+        }
+        return mask;
+    }
+};
+
+#ifdef RT_SIMD_SSE
+template <>
+struct slab_kernel<4> {
+    __m128 origin[3];  // 预先广播到SIMD寄存器中
+    __m128 inv_dir[3];
+
+    explicit slab_kernel(const ray &r) {
+        const auto &org = r.origin();
+        const auto &direction_inv = r.inv_direction();
+        for (int i = 0; i < 3; i++) {
+            origin[i] = _mm_set1_ps(org[i]);
+            inv_dir[i] = _mm_set1_ps(direction_inv[i]);
+        }
+    }
+
+    int operator()(const wide_bvh_node<4> &node, float tmin, float tmax,
+                   std::array<float, 4> &tnear) const {
+        __m128 vnear = _mm_set1_ps(tmin);
+        __m128 vfar = _mm_set1_ps(tmax);
+        for (int axis = 0; axis < 3; axis++) {
+            const __m128 t0 = _mm_mul_ps(
+                _mm_sub_ps(_mm_load_ps(node.low[axis].data()), origin[axis]), inv_dir[axis]);
+            const __m128 t1 = _mm_mul_ps(
+                _mm_sub_ps(_mm_load_ps(node.high[axis].data()), origin[axis]), inv_dir[axis]);
+            // 原点位于包围盒的某个面上且方向分量为0时参数是0*inf=NaN, 与aabb::entry一样这一轴
+            // 不限制参数区间: 把含NaN的通道置为NaN, 再利用minps/maxps在任一操作数为NaN时
+            // 返回第二个操作数的规则保留原来的vnear与vfar
+            const __m128 nan = _mm_cmpunord_ps(t0, t1);
+            vnear = _mm_max_ps(_mm_or_ps(_mm_min_ps(t0, t1), nan), vnear);
+            vfar = _mm_min_ps(_mm_or_ps(_mm_max_ps(t0, t1), nan), vfar);
+        }
+        _mm_storeu_ps(tnear.data(), vnear);
+        return _mm_movemask_ps(_mm_cmplt_ps(vnear, vfar));
+    }
+};
+#endif
+
+#ifdef RT_SIMD_AVX2
+template <>
+struct slab_kernel<8> {
+    __m256 origin[3];
+    __m256 inv_dir[3];
+
+    RT_TARGET_AVX2 explicit slab_kernel(const ray &r) {
+        const auto &org = r.origin();
+        const auto &direction_inv = r.inv_direction();
+        for (int i = 0; i < 3; i++) {
+            origin[i] = _mm256_set1_ps(org[i]);
+            inv_dir[i] = _mm256_set1_ps(direction_inv[i]);
+        }
+    }
+
+    RT_TARGET_AVX2 int operator()(const wide_bvh_node<8> &node, float tmin, float tmax,
+                                  std::array<float, 8> &tnear) const {
+        __m256 vnear = _mm256_set1_ps(tmin);
+        __m256 vfar = _mm256_set1_ps(tmax);
+        for (int axis = 0; axis < 3; axis++) {
+            const __m256 t0 = _mm256_mul_ps(
+                _mm256_sub_ps(_mm256_load_ps(node.low[axis].data()), origin[axis]),
+                inv_dir[axis]);
+            const __m256 t1 = _mm256_mul_ps(
+                _mm256_sub_ps(_mm256_load_ps(node.high[axis].data()), origin[axis]),
+                inv_dir[axis]);
+            // 与SSE版本相同, 含NaN的通道保留原来的vnear与vfar
+            const __m256 nan = _mm256_cmp_ps(t0, t1, _CMP_UNORD_Q);
+            vnear = _mm256_max_ps(_mm256_or_ps(_mm256_min_ps(t0, t1), nan), vnear);
+            vfar = _mm256_min_ps(_mm256_or_ps(_mm256_max_ps(t0, t1), nan), vfar);
+        }
+        _mm256_storeu_ps(tnear.data(), vnear);
+        return _mm256_movemask_ps(_mm256_cmp_ps(vnear, vfar, _CMP_LT_OQ));
+    }
+};
+#endif
+
+/**
+ * @brief 用显式栈遍历多叉树, 相交的子节点按入射参数排序后入栈, 最近的子节点最先被访问
+ */
+template <int Width>
+isect_res_t traverse(const std::vector<wide_bvh_node<Width>> &nodes,
+                     const leaf_blocks<Width> &leaves, const ray &r, float tmin, float tmax) {
+    if (nodes.empty()) {
+        return std::nullopt;
+    }
+    struct entry {
+        std::uint32_t index;
+        std::uint16_t count;  // 大于0时表示叶子
+        prim_kind kind;
+        float tnear;
+    };
+    // 每层至多留下Width-1个兄弟节点, 再加上当前节点的Width个子节点
+    std::array<entry, (Width - 1) * bvh::max_depth + Width> stack{};
+    int top = 0;
+    stack[top++] = {0, 0, prim_kind::triangle, tmin};
+
+    const slab_kernel<Width> kernel{r};
+    isect_res_t res = std::nullopt;
+    while (top > 0) {
+        const auto current = stack[--top];
+        if (current.tnear >= tmax) {
+            continue;
+        }
+        if (current.count > 0) {
+            const auto isect =
+                leaves.intersect(current.kind, current.index, current.count, r, tmin, tmax);
+            if (isect.has_value()) {
+                tmax = isect->ray_param;
+                res = isect;
+            }
+            continue;
+        }
+
+        const auto &node = nodes[current.index];
+        std::array<float, Width> tnear{};
+        const int mask = kernel(node, tmin, tmax, tnear);
+        // 按入射参数从远到近入栈
+        const int first = top;
+        for (int child = 0; child < Width; child++) {
+            if ((mask & (1 << child)) == 0) {
+                continue;
+            }
+            const entry next{node.children[child], node.counts[child], node.kinds[child],
+                             tnear[child]};
+            int pos = top++;
+            while (pos > first && stack[pos - 1].tnear < next.tnear) {
+                stack[pos] = stack[pos - 1];
+                pos--;
+            }
+            stack[pos] = next;
+        }
+    }
+    return res;
+}
+
+/**
+ * @brief 遮挡查询: 找到任意一个交点即返回, 子节点不需要排序
+ */
+template <int Width>
+bool any_hit(const std::vector<wide_bvh_node<Width>> &nodes, const leaf_blocks<Width> &leaves,
+             const ray &r, float tmin, float tmax) {
+    if (nodes.empty()) {
+        return false;
+    }
+    struct entry {
+        std::uint32_t index;
+        std::uint16_t count;
+        prim_kind kind;
+    };
+    std::array<entry, (Width - 1) * bvh::max_depth + Width> stack{};
+    int top = 0;
+    stack[top++] = {0, 0, prim_kind::triangle};
+
+    const slab_kernel<Width> kernel{r};
+    while (top > 0) {
+        const auto current = stack[--top];
+        if (current.count > 0) {
+            if (leaves.occluded(current.kind, current.index, current.count, r, tmin, tmax)) {
+                return true;
+            }
+            continue;
+        }
+        const auto &node = nodes[current.index];
+        std::array<float, Width> tnear{};
+        const int mask = kernel(node, tmin, tmax, tnear);
+        for (int child = 0; child < Width; child++) {
+            if ((mask & (1 << child)) != 0) {
+                stack[top++] = {node.children[child], node.counts[child], node.kinds[child]};
+            }
+        }
+    }
+    return false;
+}
+
+#ifdef RT_SIMD_AVX2
+// flatten使遍历循环与求交函数都内联进来, 一起按AVX2编译
+RT_TARGET_AVX2 RT_FLATTEN isect_res_t traverse_avx2(const std::vector<wide_bvh_node<8>> &nodes,
+                                                    const leaf_blocks<8> &leaves, const ray &r,
+                                                    float tmin, float tmax) {
+    return traverse<8>(nodes, leaves, r, tmin, tmax);
+}
+
+RT_TARGET_AVX2 RT_FLATTEN bool any_hit_avx2(const std::vector<wide_bvh_node<8>> &nodes,
+                                            const leaf_blocks<8> &leaves, const ray &r, float tmin,
+                                            float tmax) {
+    return any_hit<8>(nodes, leaves, r, tmin, tmax);
+}
+#endif
+}  // namespace
+
+template <int Width>
+wide_bvh<Width>::wide_bvh(const bvh &binary) : leaves_(binary.leaves<Width>()) {
+    const auto &binary_nodes = binary.nodes();
+    if (binary_nodes.empty()) {
+        return;
+    }
+    nodes_.reserve(binary_nodes.size() / (Width / 2) + 1);
+    collapse(binary_nodes, 0);
+}
+
+template <int Width>
+std::uint32_t wide_bvh<Width>::collapse(const std::vector<bvh_node> &binary,
+                                        std::uint32_t index) {
+    // 从二叉节点出发, 反复展开表面积最大的内部子节点, 直到凑满Width个子节点
+    std::array<std::uint32_t, Width> slots{index};
+    int n_slots = 1;
+    if (!binary[index].is_leaf()) {
+        slots[0] = index + 1;
+        slots[1] = binary[index].offset;
+        n_slots = 2;
+    }
+    while (n_slots < Width) {
+        int widest = -1;
+        float widest_area = -1;
+        for (int i = 0; i < n_slots; i++) {
+            const auto &node = binary[slots[i]];
+            if (!node.is_leaf() && node.bounding.area() > widest_area) {
+                widest = i;
+                widest_area = node.bounding.area();
+            }
+        }
+        if (widest < 0) {
+            break;
+        }
+        const auto opened = slots[widest];
+        slots[widest] = opened + 1;
+        slots[n_slots++] = binary[opened].offset;
+    }
+
+    // 空位的包围盒放在无穷远处, 与任何光线都不相交
+    const auto result = (std::uint32_t)nodes_.size();
+    wide_bvh_node<Width> node{};
+    constexpr auto inf = std::numeric_limits<float>::infinity();
+    for (int axis = 0; axis < 3; axis++) {
+        node.low[axis].fill(inf);
+        node.high[axis].fill(inf);
+    }
+    nodes_.push_back(node);
+
+    for (int i = 0; i < n_slots; i++) {
+        const auto &child = binary[slots[i]];
+        std::uint32_t target = child.offset;
+        if (!child.is_leaf()) {
+            target = collapse(binary, slots[i]);
+        }
+        auto &current = nodes_[result];
+        for (int axis = 0; axis < 3; axis++) {
+            current.low[axis][i] = child.bounding.low()[axis];
+            current.high[axis][i] = child.bounding.high()[axis];
+        }
+        current.children[i] = target;
+        current.counts[i] = child.count;
+        current.kinds[i] = child.kind;
+    }
+    return result;
+}
+
+template <int Width>
+isect_res_t wide_bvh<Width>::intersect(const ray &r, float tmin, float tmax) const {
+    return traverse<Width>(nodes_, leaves_, r, tmin, tmax);
+}
+
+template <>
+isect_res_t wide_bvh<8>::intersect(const ray &r, float tmin, float tmax) const {
+#ifdef RT_SIMD_AVX2
+    return traverse_avx2(nodes_, leaves_, r, tmin, tmax);
+#else
+    return traverse<8>(nodes_, leaves_, r, tmin, tmax);
+#endif
+}
+
+template <int Width>
+bool wide_bvh<Width>::occluded(const ray &r, float tmin, float tmax) const {
+    return any_hit<Width>(nodes_, leaves_, r, tmin, tmax);
+}
+
+template <>
+bool wide_bvh<8>::occluded(const ray &r, float tmin, float tmax) const {
+#ifdef RT_SIMD_AVX2
+    return any_hit_avx2(nodes_, leaves_, r, tmin, tmax);
+#else
+    return any_hit<8>(nodes_, leaves_, r, tmin, tmax);
+#endif
+}
+
+template class wide_bvh<4>;
+template class wide_bvh<8>;
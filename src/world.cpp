@@ -0,0 +1,109 @@
+#include "world.hpp"
+
+#include <algorithm>
+
+namespace {
+/**
+ * @brief 按order重排一类图元, 见world_t::reorder()
+ */
+template <typename T>
+void gather(std::vector<T> &prims, const std::vector<std::uint32_t> &order) {
+    std::vector<T> reordered;
+    reordered.reserve(order.size());
+    for (const auto index : order) {
+        reordered.push_back(prims[index]);
+    }
+    prims = std::move(reordered);
+}
+
+const hittable &as_hittable(const hittable &prim) { return prim; }
+
+const hittable &as_hittable(const std::shared_ptr<hittable> &prim) { return *prim; }
+
+/**
+ * @brief 与一类图元逐个求交, 找到更近的交点时更新tmax与res
+ */
+template <typename T>
+void intersect_all(const std::vector<T> &prims, const ray &r, float tmin, float &tmax,
+                   isect_res_t &res) {
+    for (auto &&prim : prims) {
+        const auto isect = as_hittable(prim).intersect(r, tmin, tmax);
+        if (isect.has_value()) {
+            tmax = isect->ray_param;
+            res = isect;
+        }
+    }
+}
+
+template <typename T>
+bool any_occluded(const std::vector<T> &prims, const ray &r, float tmin, float tmax) {
+    return std::any_of(prims.begin(), prims.end(), [&](const T &prim) {
+        return as_hittable(prim).occluded(r, tmin, tmax);
+    });
+}
+}  // namespace
+
+aabb world_t::bounding_box(prim_kind kind, std::uint32_t index) const {
+    switch (kind) {
+        case prim_kind::triangle:
+            return mesh.face_bounds(index);
+        case prim_kind::sphere:
+            return spheres[index].bounding_box();
+        case prim_kind::rectangle:
+            return rectangles[index].bounding_box();
+        default:
+            return objects[index]->bounding_box();
+    }
+}
+
+aabb world_t::clipped_bounding_box(prim_kind kind, std::uint32_t index, int axis, float low,
+                                   float high) const {
+    switch (kind) {
+        case prim_kind::triangle:
+            return mesh.clipped_face_bounds(index, axis, low, high);
+        case prim_kind::sphere:
+            return spheres[index].clipped_bounding_box(axis, low, high);
+        case prim_kind::rectangle:
+            return rectangles[index].clipped_bounding_box(axis, low, high);
+        default:
+            return objects[index]->clipped_bounding_box(axis, low, high);
+    }
+}
+
+void world_t::reorder(prim_kind kind, const std::vector<std::uint32_t> &order) {
+    switch (kind) {
+        case prim_kind::triangle:
+            mesh.reorder_faces(order);
+            break;
+        case prim_kind::sphere:
+            gather(spheres, order);
+            break;
+        case prim_kind::rectangle:
+            gather(rectangles, order);
+            break;
+        default:
+            gather(objects, order);
+            break;
+    }
+}
+
+isect_res_t intersect(const world_t &world, const ray &r, float tmin, float tmax) {
+    isect_res_t res = world.mesh.intersect(r, tmin, tmax);
+    if (res.has_value()) {
+        tmax = res->ray_param;
+    }
+    intersect_all(world.spheres, r, tmin, tmax, res);
+    intersect_all(world.rectangles, r, tmin, tmax, res);
+    intersect_all(world.objects, r, tmin, tmax, res);
+    return res;
+}
+
+hit_res_t hit(const world_t &world, const ray &r, float tmin, float tmax) {
+    return to_record(r, intersect(world, r, tmin, tmax));
+}
+
+bool occluded(const world_t &world, const ray &r, float tmin, float tmax) {
+    return world.mesh.occluded(r, tmin, tmax) || any_occluded(world.spheres, r, tmin, tmax) ||
+           any_occluded(world.rectangles, r, tmin, tmax) ||
+           any_occluded(world.objects, r, tmin, tmax);
+}
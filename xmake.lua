@@ -25,3 +25,65 @@ target("rt")
         os.cp(targetfile, filepath)
         print("binary at: %s", filepath)
     end)
+
+-- 三角形求交的微基准, 不参与默认构建: xmake build triangle_bench && xmake run triangle_bench
+target("triangle_bench")
+    set_languages("c++17")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("include")
+    add_includedirs("deps")
+    add_files("bench/triangle_bench.cpp", "src/triangle.cpp", "src/hittable.cpp", "src/utils.cpp")
+    set_warnings("all")
+
+-- 包围盒求交的微基准, 不参与默认构建: xmake build aabb_bench && xmake run aabb_bench
+target("aabb_bench")
+    set_languages("c++17")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("include")
+    add_includedirs("deps")
+    add_files("bench/aabb_bench.cpp")
+    set_warnings("all")
+
+-- 材质引用方式的多线程基准, 不参与默认构建: xmake build material_bench && xmake run material_bench
+target("material_bench")
+    set_languages("c++17")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("include")
+    add_includedirs("deps")
+    add_files("bench/material_bench.cpp", "src/*.cpp|main.cpp|parser.cpp")
+    set_warnings("all")
+
+    if is_plat("linux") then
+        add_syslinks("tbb", "pthread")
+    end
+
+-- 不使用bvh时场景求交的微基准, 不参与默认构建: xmake build world_bench && xmake run world_bench
+target("world_bench")
+    set_languages("c++17")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("include")
+    add_includedirs("deps")
+    add_files("bench/world_bench.cpp", "src/*.cpp|main.cpp|parser.cpp")
+    set_warnings("all")
+
+    if is_plat("linux") then
+        add_syslinks("tbb", "pthread")
+    end
+
+-- 多叉bvh遍历的微基准, 不参与默认构建: xmake build wide_bvh_bench && xmake run wide_bvh_bench
+target("wide_bvh_bench")
+    set_languages("c++17")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("include")
+    add_includedirs("deps")
+    add_files("bench/wide_bvh_bench.cpp", "src/*.cpp|main.cpp|parser.cpp")
+    set_warnings("all")
+
+    if is_plat("linux") then
+        add_syslinks("tbb", "pthread")
+    end